@@ -19,9 +19,23 @@
 #ifndef ASSIGNMENTS_DG_GRAPH_H_
 #define ASSIGNMENTS_DG_GRAPH_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace gdwg {
@@ -33,11 +47,13 @@ class Graph {
   struct Edge;
   /* Node data structure that stores a generic value,
    * incoming and outgoing edges, in and out degrees
+   * and its position in nodes_, which doubles as a dense index
    */
   struct Node {
     N value_;
     int indegree_ = 0;
     int outdegree_ = 0;
+    std::size_t index_ = 0;
   };
   /* Edge data structure that stores a generic weight,
    * source and destination nodes.
@@ -47,6 +63,36 @@ class Graph {
     std::weak_ptr<Node> src_;
     std::weak_ptr<Node> dest_;
   };
+  /* Every node, edge and the vectors holding them are allocated from the graph's
+   * std::pmr::memory_resource (see GetMemoryResource).
+   */
+  using NodeList = std::pmr::vector<std::shared_ptr<Node>>;
+  using EdgeList = std::pmr::vector<std::shared_ptr<Edge>>;
+  /* A single entry in a Transaction's undo log. Only the fields relevant
+   * to kind_ are populated; each records just enough to reverse one change.
+   */
+  struct UndoRecord {
+    enum class Kind {
+      kInsertNode,
+      kDeleteNode,
+      kInsertEdge,
+      kEraseEdge,
+      kReplace,
+      kRetarget,
+      kClear
+    };
+    Kind kind_;
+    std::size_t position_ = 0;
+    std::size_t in_position_ = 0;
+    std::shared_ptr<Node> node_;
+    std::shared_ptr<Edge> edge_;
+    std::weak_ptr<Node> src_;
+    std::weak_ptr<Node> dest_;
+    std::optional<N> value_;
+    NodeList nodes_;
+    EdgeList edges_;
+    EdgeList in_edges_;
+  };
 
  public:
   /********************** ITERATORS **********************/
@@ -100,8 +146,8 @@ class Graph {
 
    private:
     friend class Graph<N, E>;
-    typename std::vector<std::shared_ptr<Edge>>::const_iterator iterator_;
-    typename std::vector<std::shared_ptr<Edge>>::const_iterator end_iterator_;
+    typename EdgeList::const_iterator iterator_;
+    typename EdgeList::const_iterator end_iterator_;
   };
   // CONST_REVERSE_ITERATOR
   class const_reverse_iterator {
@@ -146,8 +192,8 @@ class Graph {
 
    private:
     friend class Graph<N, E>;
-    typename std::vector<std::shared_ptr<Edge>>::const_reverse_iterator iterator_;
-    typename std::vector<std::shared_ptr<Edge>>::const_reverse_iterator end_iterator_;
+    typename EdgeList::const_reverse_iterator iterator_;
+    typename EdgeList::const_reverse_iterator end_iterator_;
   };
 
   const_iterator find(const N&, const N&, const E&);
@@ -178,13 +224,257 @@ class Graph {
   const_reverse_iterator crbegin() const noexcept;
   const_reverse_iterator crend() const noexcept;
 
+  // EDGE_RANGE
+  // A range of the edges leaving, or entering, one node, as returned by EdgesFrom and EdgesTo.
+  // Its iterators yield the same (src, dst, weight) tuples as const_iterator.
+  class EdgeRange {
+   public:
+    const_iterator begin() const { return first_; }
+    const_iterator end() const { return last_; }
+    bool empty() const { return first_ == last_; }
+
+   private:
+    friend class Graph<N, E>;
+    const_iterator first_;
+    const_iterator last_;
+  };
+
+  EdgeRange EdgesFrom(const N&) const;
+  EdgeRange EdgesTo(const N&) const;
+
+  /********************** CHANGE LOG **********************/
+  // A Delta is one successful mutation of a graph, as recorded by its change log. node_ is the
+  // node inserted, deleted or replaced, or the src of an edge; other_ is the dst of an edge or
+  // the new value of a Replace or MergeReplace; weight_ is the weight of an edge. A kClear
+  // delta carries no data, its node_ is just one of the nodes that was cleared.
+  // Deltas are numbered from 1 by sequence_, in the order they were made.
+  struct Delta {
+    enum class Kind {
+      kInsertNode,
+      kInsertEdge,
+      kDeleteNode,
+      kEraseEdge,
+      kReplace,
+      kMergeReplace,
+      kClear
+    };
+    Kind kind_;
+    std::uint64_t sequence_;
+    N node_;
+    std::optional<N> other_;
+    std::optional<E> weight_;
+  };
+
+  // The change log is off by default and costs nothing until enabled. Once enabled, every
+  // successful InsertNode, InsertEdge, DeleteNode, erase, Replace, MergeReplace and clear is
+  // recorded as a Delta. A replica that is a copy of the graph taken at ChangeSequence() s
+  // is kept up to date by passing each of DeltasSince(s) to its ApplyDelta.
+  // Subscribers are called with each Delta as it is recorded, and must not change the graph.
+  // Changes made inside a Transaction are only recorded when it commits.
+  void EnableChangeLog();
+  void DisableChangeLog() noexcept;
+  bool IsChangeLogEnabled() const noexcept { return change_log_ != nullptr; }
+  std::uint64_t ChangeSequence() const noexcept;
+  std::vector<Delta> DeltasSince(std::uint64_t) const;
+  void TrimChangeLog(std::uint64_t) noexcept;
+  std::size_t Subscribe(std::function<void(const Delta&)>);
+  void Unsubscribe(std::size_t) noexcept;
+  void ApplyDelta(const Delta&);
+
+  /********************** DIFFS **********************/
+  // A Patch is the minimal set of node and edge changes that turns one graph into another, as
+  // returned by Diff(from, to). Each vector is sorted, in the same order as the graph's own.
+  struct Patch {
+    std::vector<N> removed_nodes_;
+    std::vector<N> added_nodes_;
+    std::vector<std::tuple<N, N, E>> removed_edges_;
+    std::vector<std::tuple<N, N, E>> added_edges_;
+  };
+
+  void ApplyPatch(const Patch&);
+
+  /********************** EXTERNAL MEMORY **********************/
+  // IngestEdgeList converts a text edge list, one "src dst weight" per line, into a binary
+  // compressed sparse row (CSR) file without ever holding the whole edge list in memory. Edges
+  // are read in chunks, sorted into runs that are spilled to files next to the CSR file, and
+  // the runs are k-way merged. memory_budget bounds the bytes of records held in memory at
+  // once, besides one file buffer per run being merged. Duplicate edges are dropped, as
+  // InsertEdge would. N and E must be trivially copyable and readable with operator>>.
+  // LoadCsr builds a graph from a CSR file in a single linear pass.
+  // Both throw a std::runtime_error if a file can't be read or written, or is malformed.
+  struct IngestStats {
+    std::size_t nodes_ = 0;
+    std::size_t edges_ = 0;
+    // How many sorted runs were spilled to disk, 0 if everything fit in the budget
+    std::size_t runs_ = 0;
+  };
+
+  static IngestStats IngestEdgeList(const std::string& edge_list_path,
+                                    const std::string& csr_path,
+                                    std::size_t memory_budget = std::size_t{64} << 20);
+  static Graph LoadCsr(const std::string&,
+                       std::pmr::memory_resource* = std::pmr::get_default_resource());
+
+  // ParseEdgeList builds a graph in memory from the same text edge lists, as fast as possible.
+  // The file is mapped rather than read, and split at line boundaries into chunks that threads
+  // threads (0 means one per hardware thread, for large enough files) parse in parallel with
+  // std::from_chars. Each distinct node name is interned once, and edges are kept as pairs of
+  // node indices until the graph is built, already sorted, in a single pass. N must be
+  // arithmetic or constructible from a std::string_view, and E arithmetic.
+  // Throws a std::runtime_error if the file can't be mapped or a line can't be parsed.
+  static Graph ParseEdgeList(const std::string&,
+                             unsigned threads = 0,
+                             std::pmr::memory_resource* = std::pmr::get_default_resource());
+
+  /********************** TRANSACTIONS **********************/
+  // A Transaction batches mutations made on a graph while it is open so that they can be
+  // committed or rolled back as a whole. Every change is recorded in an undo log, so a
+  // rollback costs time proportional to the batch rather than the graph, and re-sorting
+  // of the edges is deferred until Commit(). A transaction that is destroyed without being
+  // committed is rolled back.
+  // Example:
+  //  gdwg::Graph<std::string, int>::Transaction tx{g};
+  //  g.InsertNode("a"); g.InsertEdge("a", "b", 1);
+  //  tx.Commit();
+  class Transaction {
+   public:
+    explicit Transaction(Graph&);
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+    ~Transaction();
+
+    void Commit();
+    void Rollback() noexcept;
+    bool IsActive() const noexcept { return graph_ != nullptr; }
+
+   private:
+    friend class Graph<N, E>;
+    Graph* graph_;
+    bool resort_ = false;
+    std::vector<UndoRecord> log_;
+    // Deltas made inside the transaction, published to the change log on Commit()
+    std::vector<Delta> deltas_;
+  };
+
+  /********************** TRAVERSALS **********************/
+  // A Traversal lazily visits every node reachable from a start node by following outgoing
+  // edges, either breadth first or depth first, visiting neighbours in ascending order.
+  // A node's edges are only looked up once the consumer advances past it, so breaking out of
+  // a loop stops the traversal's work. One visited bitmap and one frontier, owned by the
+  // Traversal, are used for the whole walk. The graph must not be changed while it is in use.
+  // Example:
+  //  for (const auto& node : g.BreadthFirst("a")) {
+  //    if (node == "z") break;
+  //  }
+  class Traversal {
+   public:
+    // A single pass input iterator over the nodes of the traversal, in visiting order
+    class iterator {
+     public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = N;
+      using reference = const N&;
+      using pointer = const N*;
+      using difference_type = int;
+
+      reference operator*() const { return traversal_->current_->value_; }
+      pointer operator->() const { return &(operator*()); }
+
+      iterator& operator++() {
+        traversal_->Advance();
+        return *this;
+      }
+      void operator++(int) { ++(*this); }
+
+      friend bool operator==(const iterator& lhs, const iterator& rhs) {
+        return lhs.AtEnd() == rhs.AtEnd() && (lhs.AtEnd() || lhs.traversal_ == rhs.traversal_);
+      }
+
+      friend bool operator!=(const iterator& lhs, const iterator& rhs) { return !(lhs == rhs); }
+
+     private:
+      friend class Traversal;
+      bool AtEnd() const noexcept {
+        return traversal_ == nullptr || traversal_->current_ == nullptr;
+      }
+      Traversal* traversal_ = nullptr;
+    };
+
+    iterator begin() noexcept {
+      iterator it;
+      it.traversal_ = this;
+      return it;
+    }
+    iterator end() noexcept { return iterator{}; }
+
+   private:
+    friend class Graph<N, E>;
+    Traversal(const Graph&, const Node*, bool);
+    void Advance();
+
+    const Graph* graph_;
+    bool depth_first_;
+    const Node* current_;
+    std::vector<bool> visited_;
+    std::deque<const Node*> frontier_;
+  };
+
+  Traversal BreadthFirst(const N&) const;
+  Traversal DepthFirst(const N&) const;
+
+  /********************** SHORTEST PATHS **********************/
+  // AStar answers repeated point to point shortest path queries on one graph with A* search.
+  // The heuristic passed to Search is called with a node and must never overestimate the cost
+  // of the cheapest path from it to dst; edge weights must not be negative and E must support
+  // +, < and value initialisation to zero.
+  // The open set heap and the per node score arrays belong to the AStar object and are reused
+  // by every query, so once they have grown to the size of the graph Search does not allocate.
+  // Each query marks its scores with a new epoch rather than clearing the arrays.
+  // Example:
+  //  gdwg::Graph<int, double>::AStar astar{g};
+  //  auto cost = astar.Search(1, 9, [](int node) { return Distance(node, 9); });
+  //  if (cost) auto path = astar.Path();
+  class AStar {
+   public:
+    explicit AStar(const Graph& graph) : graph_{&graph} {}
+
+    template <typename Heuristic>
+    std::optional<E> Search(const N&, const N&, Heuristic);
+    std::vector<N> Path() const;
+
+   private:
+    void Prepare();
+
+    const Graph* graph_;
+    std::uint32_t epoch_ = 0;
+    std::size_t start_ = 0;
+    std::size_t goal_ = 0;
+    bool found_ = false;
+    std::vector<E> g_score_;
+    std::vector<std::size_t> came_from_;
+    // g_score_[i] is only valid when seen_[i] == epoch_, and node i is closed when
+    // closed_[i] == epoch_
+    std::vector<std::uint32_t> seen_;
+    std::vector<std::uint32_t> closed_;
+    std::vector<std::pair<E, std::size_t>> heap_;
+  };
+
   /********************** CONSTRUCTORS **********************/
+  // Every constructor optionally takes the std::pmr::memory_resource that the graph allocates
+  // its nodes and edges from, e.g. a std::pmr::monotonic_buffer_resource for short-lived graphs.
+  // The resource must outlive the graph. The default is std::pmr::get_default_resource().
   Graph() noexcept = default;
-  Graph(typename std::vector<N>::const_iterator, typename std::vector<N>::const_iterator) noexcept;
+  explicit Graph(std::pmr::memory_resource*) noexcept;
+  Graph(typename std::vector<N>::const_iterator,
+        typename std::vector<N>::const_iterator,
+        std::pmr::memory_resource* = std::pmr::get_default_resource()) noexcept;
   Graph(typename std::vector<std::tuple<N, N, E>>::const_iterator,
-        typename std::vector<std::tuple<N, N, E>>::const_iterator) noexcept;
-  Graph(std::initializer_list<N>) noexcept;
+        typename std::vector<std::tuple<N, N, E>>::const_iterator,
+        std::pmr::memory_resource* = std::pmr::get_default_resource()) noexcept;
+  Graph(std::initializer_list<N>,
+        std::pmr::memory_resource* = std::pmr::get_default_resource()) noexcept;
   Graph(const Graph&) noexcept;
+  Graph(const Graph&, std::pmr::memory_resource*) noexcept;
   Graph(Graph&&) noexcept;
   ~Graph() = default;
 
@@ -201,11 +491,100 @@ class Graph {
   bool DeleteNode(const N&);
   std::vector<N> GetConnected(const N&) const;
   std::vector<E> GetWeights(const N&, const N&) const;
-  void clear() noexcept;
+  // Not noexcept: with the change log enabled it publishes a Delta, which allocates and calls
+  // every subscriber. If either throws, the exception propagates and the graph is unchanged.
+  void clear();
   bool erase(const N&, const N&, const E&);
   bool Replace(const N&, const N&);
   void MergeReplace(const N&, const N&);
   static bool CompareSort(const std::shared_ptr<Edge>&, const std::shared_ptr<Edge>&);
+  static bool CompareSortByDest(const std::shared_ptr<Edge>&, const std::shared_ptr<Edge>&);
+  bool InTransaction() const noexcept { return transaction_ != nullptr; }
+  std::pmr::memory_resource* GetMemoryResource() const noexcept {
+    return nodes_.get_allocator().resource();
+  }
+
+  /********************** DEGREES **********************/
+  // The graph keeps a count of how many nodes have each in degree and each out degree, updated
+  // by every change, so none of these scan the edges. GetDegreeHistogram(kind)[d] is the number
+  // of nodes with degree d, up to the highest degree. TopByDegree returns the k nodes with the
+  // highest degree, highest first, with ties in ascending order.
+  // GetInDegree and GetOutDegree throw a std::out_of_range if the node doesn't exist.
+  enum class Degree { kIn, kOut };
+  int GetInDegree(const N&) const;
+  int GetOutDegree(const N&) const;
+  std::vector<std::size_t> GetDegreeHistogram(Degree) const;
+  std::vector<N> TopByDegree(std::size_t k, Degree) const;
+
+  /********************** ALGORITHMS **********************/
+  // The minimum spanning forest functions treat every edge as undirected and never pick a self
+  // edge. Edges are identified by their position in cbegin()..cend() order and ties in weight
+  // are broken by that position, so both algorithms pick the same forest, returned in ascending
+  // position order. E must be ordered by operator<.
+  std::vector<std::size_t> KruskalSpanningForest() const;
+  std::vector<std::size_t> BoruvkaSpanningForest() const;
+  Graph MinimumSpanningForest() const;
+
+  // The community of each node, as found by DetectCommunities. nodes_ is sorted, labels_[i] is
+  // the community of nodes_[i], numbered from 0 in order of first appearance, and modularity_
+  // is the weighted modularity of the partition, between -0.5 and 1.
+  struct Communities {
+    std::vector<N> nodes_;
+    std::vector<std::size_t> labels_;
+    std::size_t count_ = 0;
+    double modularity_ = 0;
+  };
+
+  // Finds communities with asynchronous label propagation over threads threads (0 means one
+  // per hardware thread), optionally refined by Louvain local moving to raise the modularity.
+  // Edges are treated as undirected and their weights, converted to double, must not be negative.
+  Communities DetectCommunities(bool refine = false,
+                                std::size_t max_iterations = 32,
+                                unsigned threads = 0) const;
+
+  // An assignment of every node to one of shard_count_ shards, as made by PartitionNodes.
+  // nodes_ is sorted and shards_[i] is the shard of nodes_[i]. edge_cut_ counts the edges whose
+  // ends are in different shards, and balance_ is the size of the largest shard over the mean
+  // size, 1 when perfectly balanced.
+  struct Partition {
+    std::vector<N> nodes_;
+    std::vector<std::size_t> shards_;
+    std::size_t shard_count_ = 0;
+    std::vector<std::size_t> shard_sizes_;
+    std::size_t edge_cut_ = 0;
+    double balance_ = 1;
+  };
+  struct Shard;
+
+  // Partitions the nodes into shards with streaming FENNEL: nodes are placed one at a time in
+  // the shard holding most of their neighbours, less a penalty that grows with the shard's
+  // size, and no shard may exceed imbalance times the mean size, rounded up. Each refinement
+  // pass then moves nodes to the shard holding strictly more of their neighbours, where there's
+  // room.
+  // Edges are treated as undirected and unweighted.
+  // Throws a std::runtime_error if shards is 0 or imbalance is below 1.
+  Partition PartitionNodes(std::size_t shards,
+                           double imbalance = 1.1,
+                           std::size_t refinement_passes = 4) const;
+  // Returns the nodes of one shard of a partition of this graph, with the edges between them,
+  // along with the boundary between it and the other shards.
+  // Throws a std::out_of_range if there's no such shard, or a std::runtime_error if the
+  // partition is of other nodes or a transaction is open.
+  Shard ExtractShard(const Partition&, std::size_t) const;
+
+  // The neighbourhoods found by KHopNeighbourhoods, stored end to end: those of seeds[i] are
+  // nodes_[offsets_[i]] up to nodes_[offsets_[i + 1]], each sorted.
+  struct Neighbourhoods {
+    std::vector<std::size_t> offsets_;
+    std::vector<N> nodes_;
+  };
+
+  // Finds the nodes reachable from each seed by following between 1 and k outgoing edges,
+  // leaving out the seed itself. Seeds are walked together, 64 at a time, by a breadth first
+  // search that keeps one bit per seed in a word per node, so the edges out of a node are
+  // followed once per level for the whole batch.
+  // Throws a std::out_of_range if a seed doesn't exist in the graph.
+  Neighbourhoods KHopNeighbourhoods(const std::vector<N>& seeds, std::size_t k) const;
 
   /************** FRIENDS ******************/
   friend bool operator==(const gdwg::Graph<N, E>& g1, const gdwg::Graph<N, E>& g2) {
@@ -232,6 +611,40 @@ class Graph {
     return true;
   }
 
+  // Returns the Patch that turns from into to. Both graphs keep their nodes and edges sorted,
+  // so the two node lists and the two edge lists are each merged in a single linear pass.
+  // Throws a std::runtime_error if either graph has an open transaction.
+  friend Patch Diff(const gdwg::Graph<N, E>& from, const gdwg::Graph<N, E>& to) {
+    if (from.transaction_ != nullptr || to.transaction_ != nullptr) {
+      throw std::runtime_error("Cannot call Graph::Diff while a transaction is open");
+    }
+    Patch patch;
+    auto from_nodes = from.GetNodes();
+    auto to_nodes = to.GetNodes();
+    std::set_difference(from_nodes.begin(), from_nodes.end(), to_nodes.begin(), to_nodes.end(),
+                        std::back_inserter(patch.removed_nodes_));
+    std::set_difference(to_nodes.begin(), to_nodes.end(), from_nodes.begin(), from_nodes.end(),
+                        std::back_inserter(patch.added_nodes_));
+
+    auto as_tuple = [](const std::shared_ptr<Edge>& edge) {
+      return std::make_tuple(edge->src_.lock()->value_, edge->dest_.lock()->value_,
+                             edge->weight_);
+    };
+    auto a = from.edges_.cbegin();
+    auto b = to.edges_.cbegin();
+    while (a != from.edges_.cend() || b != to.edges_.cend()) {
+      if (b == to.edges_.cend() || (a != from.edges_.cend() && CompareSort(*a, *b))) {
+        patch.removed_edges_.push_back(as_tuple(*a++));
+      } else if (a == from.edges_.cend() || CompareSort(*b, *a)) {
+        patch.added_edges_.push_back(as_tuple(*b++));
+      } else {
+        ++a;
+        ++b;
+      }
+    }
+    return patch;
+  }
+
   friend std::ostream& operator<<(std::ostream& os, const gdwg::Graph<N, E>& g) {
     auto nodes = g.GetNodes();
     // We can just use nodes.empty() b/c if there are no nodes in the graph its empty
@@ -258,8 +671,215 @@ class Graph {
   }
 
  private:
-  std::vector<std::shared_ptr<Node>> nodes_;
-  std::vector<std::shared_ptr<Edge>> edges_;
+  /* Union-find over node indices, with union by size and path halving */
+  struct DisjointSet {
+    explicit DisjointSet(std::size_t);
+    std::size_t Find(std::size_t) noexcept;
+    bool Union(std::size_t, std::size_t) noexcept;
+
+    std::vector<std::size_t> parent_;
+    std::vector<std::size_t> size_;
+  };
+
+  std::shared_ptr<Node> MakeNode(const Node&);
+  std::shared_ptr<Edge> MakeEdge(const Edge&);
+  void AppendNode(const Node&);
+  void Reindex(std::size_t);
+  const Node* FindNode(const N&) const noexcept;
+  std::pair<typename EdgeList::const_iterator, typename EdgeList::const_iterator>
+  OutEdges(const N&) const;
+  std::pair<typename EdgeList::const_iterator, typename EdgeList::const_iterator>
+  InEdges(const N&) const;
+  void RebuildInEdges();
+  void CountDegrees(const Node&, int);
+  void AddDegrees(Node&, int, int);
+  void RebuildDegreeIndex();
+  std::vector<std::pair<std::size_t, std::size_t>> EdgeIndices() const;
+  bool LighterEdge(std::size_t, std::size_t) const;
+  template <typename Compare>
+  static void ParallelSort(std::vector<std::size_t>&, Compare);
+
+  /* Compressed sparse row adjacency over node indices. The neighbours of node i are
+   * targets_[offsets_[i]] up to targets_[offsets_[i + 1]], each reached through the edge at
+   * positions_[k] in edges_
+   */
+  struct Adjacency {
+    std::vector<std::size_t> offsets_;
+    std::vector<std::size_t> targets_;
+    std::vector<std::size_t> positions_;
+  };
+  Adjacency MakeAdjacency(bool) const;
+
+  /* Sorts more Records than fit in memory. Once the buffer is full it is sorted and spilled to
+   * a run file named after prefix_; Finish() then merges the runs, at most kMaxFanIn at a time,
+   * and Next() yields the records in order. If nothing was spilled the records never leave
+   * memory. Run files are removed when the sorter is destroyed. Record must be trivially copyable.
+   */
+  template <typename Record, typename Compare>
+  class ExternalSorter {
+   public:
+    ExternalSorter(std::string, std::size_t, Compare);
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+    ~ExternalSorter();
+
+    void Push(const Record&);
+    void Finish();
+    bool Next(Record&);
+    std::size_t Spilled() const noexcept { return spilled_; }
+
+   private:
+    static constexpr std::size_t kMaxFanIn = 64;
+    void Spill();
+    void Open(std::size_t);
+
+    std::string prefix_;
+    std::size_t capacity_;
+    Compare compare_;
+    std::vector<Record> buffer_;
+    std::size_t position_ = 0;
+    std::size_t spilled_ = 0;
+    std::vector<std::string> runs_;
+    std::vector<std::ifstream> inputs_;
+    std::vector<std::pair<Record, std::size_t>> heap_;
+  };
+  void CopyFrom(const Graph&);
+  typename EdgeList::iterator EraseEdge(typename EdgeList::iterator);
+  void RetargetEdge(const std::shared_ptr<Edge>&,
+                    const std::shared_ptr<Node>&,
+                    const std::shared_ptr<Node>&);
+  void SortEdges();
+  void Record(UndoRecord&&);
+  void Undo(UndoRecord&) noexcept;
+  bool RemoveNode(const N&);
+  void Log(typename Delta::Kind, const N&, const N* = nullptr, const E* = nullptr);
+  void Publish(Delta&&);
+
+  NodeList nodes_;
+  EdgeList edges_;
+  // The same edges as edges_, sorted by CompareSortByDest so that the edges entering a node
+  // are contiguous too
+  EdgeList in_edges_;
+  // The transaction currently recording changes to this graph, if any
+  Transaction* transaction_ = nullptr;
+
+  /* in_[d] and out_[d] count the nodes with an in or out degree of d. Each is trimmed to end
+   * at the highest degree present, and allocates from the graph's memory resource.
+   */
+  struct DegreeIndex {
+    explicit DegreeIndex(std::pmr::memory_resource* resource) noexcept
+      : in_{resource}, out_{resource} {}
+    std::pmr::vector<std::size_t> in_;
+    std::pmr::vector<std::size_t> out_;
+  };
+  DegreeIndex degrees_{std::pmr::get_default_resource()};
+
+  /* The recorded deltas, oldest first, and the callbacks subscribed to new ones */
+  struct ChangeLog {
+    std::uint64_t first_sequence_ = 1;
+    std::deque<Delta> deltas_;
+    std::vector<std::pair<std::size_t, std::function<void(const Delta&)>>> subscribers_;
+    std::size_t next_subscriber_ = 0;
+  };
+  // Only allocated while the change log is enabled
+  std::unique_ptr<ChangeLog> change_log_;
+};
+
+// One shard of a Partition, as returned by Graph::ExtractShard. It is defined here as a Graph
+// member must be a complete type. boundary_ holds the shard's nodes that have an edge to or
+// from another shard, sorted, and cut_edges_ holds those edges in the graph's order.
+template <typename N, typename E>
+struct Graph<N, E>::Shard {
+  Graph graph_;
+  std::vector<N> boundary_;
+  std::vector<std::tuple<N, N, E>> cut_edges_;
+};
+
+/* A Graph shared between any number of reader threads and writer threads, published
+ * read-copy-update style. Readers take a Snapshot, an immutable version of the graph that
+ * stays valid for as long as they hold it; taking and releasing one never waits on a lock or
+ * on a writer. Writers are serialized with each other: each Update copies the latest version,
+ * changes the copy and atomically publishes it, so batching several changes into one Update is
+ * much cheaper than several Updates.
+ * Old versions are reclaimed by epoch: each Snapshot announces the epoch it started in, and a
+ * version retired in epoch t is deleted by a later writer once no Snapshot from epoch t or
+ * earlier is left. At most reader_slots Snapshots may be held at once; any more spin until a
+ * slot is free. The ConcurrentGraph must outlive its Snapshots.
+ * Example:
+ *  gdwg::ConcurrentGraph<std::string, int> shared{g};
+ *  // Reader thread
+ *  auto snapshot = shared.Read();
+ *  if (snapshot->IsNode("a")) { ... }
+ *  // Writer thread
+ *  shared.Update([](auto& graph) { graph.InsertNode("b"); });
+ */
+template <typename N, typename E>
+class ConcurrentGraph {
+ public:
+  class Snapshot {
+   public:
+    Snapshot(Snapshot&&) noexcept;
+    Snapshot& operator=(Snapshot&&) noexcept;
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    ~Snapshot();
+
+    const Graph<N, E>& operator*() const noexcept { return *graph_; }
+    const Graph<N, E>* operator->() const noexcept { return graph_; }
+    std::uint64_t Version() const noexcept { return version_; }
+
+   private:
+    friend class ConcurrentGraph<N, E>;
+    Snapshot(std::atomic<std::uint64_t>*, const Graph<N, E>*, std::uint64_t) noexcept;
+    void Release() noexcept;
+
+    std::atomic<std::uint64_t>* slot_;
+    const Graph<N, E>* graph_;
+    std::uint64_t version_;
+  };
+
+  explicit ConcurrentGraph(Graph<N, E> initial = Graph<N, E>{}, std::size_t reader_slots = 64);
+  ConcurrentGraph(const ConcurrentGraph&) = delete;
+  ConcurrentGraph& operator=(const ConcurrentGraph&) = delete;
+  ~ConcurrentGraph();
+
+  Snapshot Read() const;
+  // Publishes a copy of the latest version changed by update, and returns its version. If
+  // update throws, nothing is published.
+  std::uint64_t Update(const std::function<void(Graph<N, E>&)>& update);
+  std::uint64_t Publish(Graph<N, E>);
+  // Deletes the retired versions no Snapshot can still see, which every Update also does
+  void Reclaim();
+  // The number of retired versions still waiting for their readers to finish
+  std::size_t Retired() const;
+
+ private:
+  static constexpr std::uint64_t kIdle = ~std::uint64_t{0};
+  // Each slot sits on its own cache line, so readers don't contend on each other's
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> epoch_{kIdle};
+  };
+  // A version of the graph, which never moves once published
+  struct Published {
+    std::unique_ptr<Graph<N, E>> graph_;
+    std::uint64_t version_;
+  };
+  struct Retiree {
+    std::unique_ptr<Published> published_;
+    std::uint64_t epoch_;
+  };
+  std::uint64_t PublishLocked(std::unique_ptr<Graph<N, E>>);
+  void ReclaimLocked();
+
+  std::atomic<const Published*> current_;
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t slot_count_;
+  std::atomic<std::uint64_t> epoch_{0};
+  // Guards everything below, and serializes the writers
+  mutable std::mutex writer_;
+  std::unique_ptr<Published> latest_;
+  std::vector<Retiree> retired_;
+  std::uint64_t next_version_ = 1;
 };
 
 }  // namespace gdwg
@@ -1,21 +1,47 @@
 #ifndef ASSIGNMENTS_DG_GRAPH_T_
 #define ASSIGNMENTS_DG_GRAPH_T_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 /************** CONSTRUCTORS ******************/
+// Constructs an empty graph that allocates its nodes and edges from resource.
+template <typename N, typename E>
+gdwg::Graph<N, E>::Graph(std::pmr::memory_resource* resource) noexcept
+  : nodes_{resource}, edges_{resource}, in_edges_{resource}, degrees_{resource} {}
+
 // An alternate (input vector) constructor of the Graph Class.
 // The input arguments are the end and beginning iterators to a vector<N> of length L,
 // which returns a graph of nodes_ of size L with no edges.
 template <typename N, typename E>
 gdwg::Graph<N, E>::Graph(typename std::vector<N>::const_iterator start,
-                         typename std::vector<N>::const_iterator finish) noexcept {
+                         typename std::vector<N>::const_iterator finish,
+                         std::pmr::memory_resource* resource) noexcept
+  : nodes_{resource}, edges_{resource}, in_edges_{resource}, degrees_{resource} {
   // if the vector is empty, construct a default graph.
   // side note => vec.begin() == vec.end() is defined as an empty vector in C++11 onwards
   if (start == finish) {
@@ -26,7 +52,7 @@ gdwg::Graph<N, E>::Graph(typename std::vector<N>::const_iterator start,
     for (auto& N_element : to_vector) {
       Node new_node = {};
       new_node.value_ = N_element;
-      this->nodes_.push_back(std::make_shared<Node>(new_node));
+      AppendNode(new_node);
     }
   }
 }
@@ -36,9 +62,10 @@ gdwg::Graph<N, E>::Graph(typename std::vector<N>::const_iterator start,
 // A variety of checks occur in the algorithm that determine the validity of each <src_, dest_, weight_>
 // in each input tuple and what already exists in the graph.
 template <typename N, typename E>
-gdwg::Graph<N, E>::Graph(
-    typename std::vector<std::tuple<N, N, E>>::const_iterator start,
-    typename std::vector<std::tuple<N, N, E>>::const_iterator finish) noexcept {
+gdwg::Graph<N, E>::Graph(typename std::vector<std::tuple<N, N, E>>::const_iterator start,
+                         typename std::vector<std::tuple<N, N, E>>::const_iterator finish,
+                         std::pmr::memory_resource* resource) noexcept
+  : nodes_{resource}, edges_{resource}, in_edges_{resource}, degrees_{resource} {
   if (start == finish) {
     Graph();
   } else {
@@ -80,10 +107,10 @@ gdwg::Graph<N, E>::Graph(
         src_node.value_ = std::get<0>(N_element);
         src_node.outdegree_++;
         src_node.indegree_++;
-        this->nodes_.push_back(std::make_shared<Node>(src_node));
+        AppendNode(src_node);
         new_edge.src_ = this->nodes_.back();
         new_edge.dest_ = this->nodes_.back();
-        this->edges_.push_back(std::make_shared<Edge>(new_edge));
+        this->edges_.push_back(MakeEdge(new_edge));
         continue;
       }
       if (exists_src == false) {
@@ -91,7 +118,7 @@ gdwg::Graph<N, E>::Graph(
         Node src_node = {};
         src_node.value_ = std::get<0>(N_element);
         src_node.outdegree_++;
-        this->nodes_.push_back(std::make_shared<Node>(src_node));
+        AppendNode(src_node);
         new_edge.src_ = this->nodes_.back();
       }
       if (exists_dest == false) {
@@ -99,52 +126,87 @@ gdwg::Graph<N, E>::Graph(
         Node dest_node = {};
         dest_node.value_ = std::get<1>(N_element);
         dest_node.indegree_++;
-        this->nodes_.push_back(std::make_shared<Node>(dest_node));
+        AppendNode(dest_node);
         new_edge.dest_ = this->nodes_.back();
       }
-      this->edges_.push_back(std::make_shared<Edge>(new_edge));
+      this->edges_.push_back(MakeEdge(new_edge));
     }
     std::sort(this->edges_.begin(), this->edges_.end(), CompareSort);
+    RebuildInEdges();
+    RebuildDegreeIndex();
   }
 }
 
 template <typename N, typename E>
-gdwg::Graph<N, E>::Graph(std::initializer_list<N> list) noexcept {
+gdwg::Graph<N, E>::Graph(std::initializer_list<N> list,
+                         std::pmr::memory_resource* resource) noexcept
+  : nodes_{resource}, edges_{resource}, in_edges_{resource}, degrees_{resource} {
   if (list.size() == 0) {
     Graph();
   } else {
     for (const auto& N_element : list) {
       Node new_node = {};
       new_node.value_ = N_element;
-      this->nodes_.push_back(std::make_shared<Node>(new_node));
+      AppendNode(new_node);
     }
   }
 }
 
+// Returns a deep copy of a graph: the copy owns its own nodes and edges, allocated from the
+// default memory resource, so changes to one graph are never seen by the other.
 template <typename N, typename E>
 gdwg::Graph<N, E>::Graph(const gdwg::Graph<N, E>& copy) noexcept {
-  this->nodes_ = copy.nodes_;
-  this->edges_ = copy.edges_;
+  CopyFrom(copy);
 }
 
+// As the above constructor, but the copy allocates from resource.
 template <typename N, typename E>
-gdwg::Graph<N, E>::Graph(gdwg::Graph<N, E>&& tmp) noexcept {
-  this->nodes_ = std::move(tmp.nodes_);
-  this->edges_ = std::move(tmp.edges_);
+gdwg::Graph<N, E>::Graph(const gdwg::Graph<N, E>& copy,
+                         std::pmr::memory_resource* resource) noexcept
+  : nodes_{resource}, edges_{resource}, in_edges_{resource}, degrees_{resource} {
+  CopyFrom(copy);
 }
 
+// The moved-to graph takes over tmp's nodes, edges, memory resource and change log.
+template <typename N, typename E>
+gdwg::Graph<N, E>::Graph(gdwg::Graph<N, E>&& tmp) noexcept
+  : nodes_{std::move(tmp.nodes_)}, edges_{std::move(tmp.edges_)},
+    in_edges_{std::move(tmp.in_edges_)}, degrees_{std::move(tmp.degrees_)},
+    change_log_{std::move(tmp.change_log_)} {}
+
 /********************** OPERATORS **********************/
+// Deep copies tmp into this graph, keeping this graph's memory resource.
 template <typename N, typename E>
 gdwg::Graph<N, E>& gdwg::Graph<N, E>::operator=(const gdwg::Graph<N, E>& tmp) noexcept {
-  this->nodes_ = tmp.nodes_;
-  this->edges_ = tmp.edges_;
+  if (&tmp != this) {
+    CopyFrom(tmp);
+  }
   return *this;
 }
 
+// Steals tmp's nodes and edges when both graphs share a memory resource. Otherwise they are
+// deep copied, as this graph must never refer to storage owned by another resource, and tmp
+// is emptied without logging a clear, since the change log moves to this graph. The deep copy
+// allocates, so if it runs out of memory the program terminates, as with the copy operations.
 template <typename N, typename E>
 gdwg::Graph<N, E>& gdwg::Graph<N, E>::operator=(gdwg::Graph<N, E>&& tmp) noexcept {
-  this->nodes_ = std::move(tmp.nodes_);
-  this->edges_ = std::move(tmp.edges_);
+  if (&tmp == this) {
+    return *this;
+  }
+  if (*GetMemoryResource() == *tmp.GetMemoryResource()) {
+    this->nodes_ = std::move(tmp.nodes_);
+    this->edges_ = std::move(tmp.edges_);
+    this->in_edges_ = std::move(tmp.in_edges_);
+    this->degrees_ = std::move(tmp.degrees_);
+  } else {
+    CopyFrom(tmp);
+    tmp.nodes_.clear();
+    tmp.edges_.clear();
+    tmp.in_edges_.clear();
+    tmp.degrees_.in_.clear();
+    tmp.degrees_.out_.clear();
+  }
+  change_log_ = std::move(tmp.change_log_);
   return *this;
 }
 
@@ -165,9 +227,14 @@ bool gdwg::Graph<N, E>::InsertNode(const N& new_node) {
   if (IsNode(new_node)) {
     return false;
   }
+  Log(Delta::Kind::kInsertNode, new_node);
   Node additional_node = {};
   additional_node.value_ = new_node;
-  this->nodes_.push_back(std::make_shared<Node>(additional_node));
+  AppendNode(additional_node);
+  UndoRecord record = {};
+  record.kind_ = UndoRecord::Kind::kInsertNode;
+  record.position_ = nodes_.size() - 1;
+  Record(std::move(record));
   return true;
 }
 
@@ -184,20 +251,36 @@ bool gdwg::Graph<N, E>::InsertEdge(const N& src, const N& dest, const E& w) {
       return false;
     }
   }
+  Log(Delta::Kind::kInsertEdge, src, &dest, &w);
   Edge new_edge = {};
   new_edge.weight_ = w;
   for (const auto& node : nodes_) {
     if (node->value_ == src) {
-      node->outdegree_++;
+      AddDegrees(*node, 0, 1);
       new_edge.src_ = node;
     }
     if (node->value_ == dest) {
-      node->indegree_++;
+      AddDegrees(*node, 1, 0);
       new_edge.dest_ = node;
     }
   }
-  this->edges_.push_back(std::make_shared<Edge>(new_edge));
-  std::sort(this->edges_.begin(), this->edges_.end(), CompareSort);
+  auto edge = MakeEdge(new_edge);
+  if (transaction_ != nullptr) {
+    // Appended unsorted; the transaction sorts once on Commit()
+    this->edges_.push_back(edge);
+    this->in_edges_.push_back(edge);
+    UndoRecord record = {};
+    record.kind_ = UndoRecord::Kind::kInsertEdge;
+    record.position_ = edges_.size() - 1;
+    record.in_position_ = in_edges_.size() - 1;
+    Record(std::move(record));
+    transaction_->resort_ = true;
+  } else {
+    // edges_ is already sorted, so the new edge only needs to be placed, not re-sorted
+    this->edges_.insert(std::upper_bound(edges_.begin(), edges_.end(), edge, CompareSort), edge);
+    this->in_edges_.insert(
+        std::upper_bound(in_edges_.begin(), in_edges_.end(), edge, CompareSortByDest), edge);
+  }
   return true;
 }
 
@@ -206,47 +289,39 @@ bool gdwg::Graph<N, E>::DeleteNode(const N& deleted_node) {
   if (!IsNode(deleted_node)) {
     return false;
   }
+  Log(Delta::Kind::kDeleteNode, deleted_node);
+  return RemoveNode(deleted_node);
+}
 
+// Does the work of DeleteNode without recording a Delta, so that MergeReplace can use it.
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::RemoveNode(const N& deleted_node) {
   for (auto it = edges_.begin(); it != edges_.end();) {
-    if ((*it)->src_.lock()->value_ == deleted_node) {
-      (*it)->dest_.lock()->indegree_--;
-      (*it).reset();
-      it = edges_.erase(it);
-    } else {
-      ++it;
-    }
-  }
-  for (auto it = edges_.begin(); it != edges_.end();) {
-    if ((*it)->dest_.lock()->value_ == deleted_node) {
-      (*it)->src_.lock()->outdegree_--;
-      (*it).reset();
-      it = edges_.erase(it);
+    if ((*it)->src_.lock()->value_ == deleted_node || (*it)->dest_.lock()->value_ == deleted_node) {
+      it = EraseEdge(it);
     } else {
       ++it;
     }
   }
   for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
     if ((*it)->value_ == deleted_node) {
-      // auto i = &node - &nodes_[0];
-      (*it).reset();
-      nodes_.erase(it);
+      UndoRecord record = {};
+      record.kind_ = UndoRecord::Kind::kDeleteNode;
+      record.position_ = it - nodes_.begin();
+      CountDegrees(**it, -1);
+      record.node_ = std::move(*it);
+      Reindex(nodes_.erase(it) - nodes_.begin());
+      Record(std::move(record));
       break;
     }
   }
-  // After every change to the edges_ vector of the graph, reshuffle the edges
-  // using CompareSort.  
-  std::sort(this->edges_.begin(), this->edges_.end(), CompareSort);
+  // Erasing from edges_ keeps the remaining edges in CompareSort order, so no re-sort is needed
   return true;
 }
 
 template <typename N, typename E>
 bool gdwg::Graph<N, E>::IsNode(const N& node) const noexcept {
-  for (auto& element : this->nodes_) {
-    if (node == element.get()->value_) {
-      return true;
-    }
-  }
-  return false;
+  return FindNode(node) != nullptr;
 }
 
 template <typename N, typename E>
@@ -278,9 +353,23 @@ std::vector<E> gdwg::Graph<N, E>::GetWeights(const N& src, const N& dest) const
 }
 
 template <typename N, typename E>
-void gdwg::Graph<N, E>::clear() noexcept {
+void gdwg::Graph<N, E>::clear() {
+  if (!nodes_.empty()) {
+    Log(Delta::Kind::kClear, nodes_.front()->value_);
+  }
+  if (transaction_ != nullptr) {
+    // Hand the whole graph to the undo log rather than recording each node and edge. The lists
+    // are move constructed into the record, which keeps the graph's allocator and takes their
+    // buffers; assigning them would copy every element onto the default resource.
+    UndoRecord record = {UndoRecord::Kind::kClear, 0, 0, nullptr, nullptr, {}, {}, std::nullopt,
+                         std::move(nodes_), std::move(edges_), std::move(in_edges_)};
+    Record(std::move(record));
+  }
   nodes_.clear();
   edges_.clear();
+  in_edges_.clear();
+  degrees_.in_.clear();
+  degrees_.out_.clear();
 }
 
 template <typename N, typename E>
@@ -288,13 +377,9 @@ bool gdwg::Graph<N, E>::erase(const N& src, const N& dest, const E& w) {
   for (auto it = edges_.begin(); it != edges_.end(); ++it) {
     if ((*it)->src_.lock()->value_ == src && (*it)->dest_.lock()->value_ == dest &&
         (*it)->weight_ == w) {
-      (*it)->src_.lock()->outdegree_--;
-      (*it)->dest_.lock()->indegree_--;
-      (*it).reset();
-      edges_.erase(it);
-      // After every change to the edges_ vector of the graph, reshuffle the edges
-      // using CompareSort. 
-      std::sort(this->edges_.begin(), this->edges_.end(), CompareSort);
+      // Logged before erasing, as src, dest and w may refer to the erased edge itself
+      Log(Delta::Kind::kEraseEdge, src, &dest, &w);
+      EraseEdge(it);
       return true;
     }
   }
@@ -325,12 +410,20 @@ bool gdwg::Graph<N, E>::Replace(const N& oldData, const N& newData) {
   if (IsNode(newData)) {
     return false;
   }
+  Log(Delta::Kind::kReplace, oldData, &newData);
   for (auto& node : nodes_) {
     if (node->value_ == oldData) {
+      UndoRecord record = {};
+      record.kind_ = UndoRecord::Kind::kReplace;
+      record.node_ = node;
+      record.value_ = std::move(node->value_);
       node->value_ = newData;
+      Record(std::move(record));
       break;
     }
   }
+  // The renamed node may now sort differently against its neighbours
+  SortEdges();
   return true;
 }
 
@@ -341,6 +434,7 @@ void gdwg::Graph<N, E>::MergeReplace(const N& oldData, const N& newData) {
                              "on old or new data if they don't exist in the graph");
   }
 
+  Log(Delta::Kind::kMergeReplace, oldData, &newData);
   auto future_edges = GetWeights(newData, newData);
 
   // loop through nodes_, find the node we want to change to (newData)
@@ -348,28 +442,25 @@ void gdwg::Graph<N, E>::MergeReplace(const N& oldData, const N& newData) {
     if (node->value_ == newData) {
       // loop through edges_, replace all the src_ and dest_ nodes in each edge with newData
       for (const auto& edge : edges_) {
-        if (edge->src_.lock()->value_ == oldData) {
-          auto current_edge = edge->weight_;
-          // if the edge of newData -> newData + weight already exists in the graph, the current
-          // edge, oldData -> newData + weight, wont be inserted into the graph
-          if (std::find(future_edges.begin(), future_edges.end(), current_edge) != future_edges.end())
-            continue;
-          edge->src_ = node;
-          node->outdegree_++;
-        }
-        if (edge->dest_.lock()->value_ == oldData) {
-          auto current_edge = edge->weight_;
-          // as above
-          if (std::find(future_edges.begin(), future_edges.end(), current_edge) != future_edges.end())
-            continue;
-          edge->dest_ = node;
-          node->indegree_++;
+        auto src = edge->src_.lock();
+        auto dest = edge->dest_.lock();
+        if (src->value_ != oldData && dest->value_ != oldData) {
+          continue;
         }
+        // if the edge of newData -> newData + weight already exists in the graph, the current
+        // edge, oldData -> newData + weight, wont be inserted into the graph
+        auto current_edge = edge->weight_;
+        if (std::find(future_edges.begin(), future_edges.end(), current_edge) != future_edges.end())
+          continue;
+        RetargetEdge(edge, src->value_ == oldData ? node : src,
+                     dest->value_ == oldData ? node : dest);
       }
       break;
     }
   }
-  DeleteNode(oldData);
+  // Re-sort before deleting, as RemoveNode relies on in_edges_ being in order
+  SortEdges();
+  RemoveNode(oldData);
 }
 
 // CompareSort -- NOT IN SPECIFICATION --
@@ -400,159 +491,2392 @@ bool gdwg::Graph<N, E>::CompareSort(const std::shared_ptr<Edge>& a,
   return false;
 }
 
-/************** ITERATORS ******************/
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::operator++() {
-  ++iterator_;
-  return *this;
-}
-
+/************** ALGORITHMS ******************/
+// Kruskal's algorithm. The edges are sorted by weight in parallel, then added lightest first
+// whenever they join two different trees of the forest, tracked with a union-find.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::operator--() {
-  --iterator_;
-  return *this;
-}
+std::vector<std::size_t> gdwg::Graph<N, E>::KruskalSpanningForest() const {
+  auto ends = EdgeIndices();
+  std::vector<std::size_t> order(edges_.size());
+  std::iota(order.begin(), order.end(), 0);
+  ParallelSort(order, [this](std::size_t a, std::size_t b) { return LighterEdge(a, b); });
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cbegin() const noexcept {
-  const_iterator it;
-  it.iterator_ = edges_.cbegin();
-  it.end_iterator_ = edges_.cend();
-  return it;
+  DisjointSet components{nodes_.size()};
+  std::vector<std::size_t> forest;
+  for (auto i : order) {
+    // A spanning tree over every node has been found, no more edges can be added
+    if (forest.size() + 1 == nodes_.size()) {
+      break;
+    }
+    if (components.Union(ends[i].first, ends[i].second)) {
+      forest.push_back(i);
+    }
+  }
+  std::sort(forest.begin(), forest.end());
+  return forest;
 }
 
+// Boruvka's algorithm. Each round finds the lightest edge leaving every tree of the forest and
+// adds them all, at least halving the number of trees. Edges found to be inside a single tree
+// are dropped so that later rounds only scan the edges that can still join two trees.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cend() const noexcept {
-  const_iterator it;
-  it.iterator_ = edges_.cend();
-  it.end_iterator_ = edges_.cend();
-  return it;
-}
+std::vector<std::size_t> gdwg::Graph<N, E>::BoruvkaSpanningForest() const {
+  auto ends = EdgeIndices();
+  std::vector<std::size_t> live(edges_.size());
+  std::iota(live.begin(), live.end(), 0);
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cbegin() noexcept {
-  const_iterator it;
-  it.iterator_ = edges_.cbegin();
-  it.end_iterator_ = edges_.cend();
-  return it;
+  const auto none = edges_.size();
+  DisjointSet components{nodes_.size()};
+  std::vector<std::size_t> cheapest(nodes_.size(), none);
+  std::vector<std::size_t> forest;
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    std::size_t kept = 0;
+    for (auto i : live) {
+      auto a = components.Find(ends[i].first);
+      auto b = components.Find(ends[i].second);
+      if (a == b) {
+        continue;
+      }
+      live[kept++] = i;
+      if (cheapest[a] == none || LighterEdge(i, cheapest[a])) {
+        cheapest[a] = i;
+      }
+      if (cheapest[b] == none || LighterEdge(i, cheapest[b])) {
+        cheapest[b] = i;
+      }
+    }
+    live.resize(kept);
+    for (auto& i : cheapest) {
+      if (i != none && components.Union(ends[i].first, ends[i].second)) {
+        forest.push_back(i);
+        merged = true;
+      }
+      i = none;
+    }
+  }
+  std::sort(forest.begin(), forest.end());
+  return forest;
 }
 
+// Returns a new graph, on the same memory resource, with every node of this graph and only the
+// edges of its minimum spanning forest. The edges keep their original direction.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cend() noexcept {
-  const_iterator it;
-  it.iterator_ = edges_.cend();
-  it.end_iterator_ = edges_.cend();
-  return it;
+gdwg::Graph<N, E> gdwg::Graph<N, E>::MinimumSpanningForest() const {
+  Graph forest{GetMemoryResource()};
+  forest.nodes_.reserve(nodes_.size());
+  for (const auto& node : nodes_) {
+    Node new_node = {};
+    new_node.value_ = node->value_;
+    forest.AppendNode(new_node);
+  }
+  // The chosen edges are in position order, so they are already in CompareSort order
+  for (auto i : KruskalSpanningForest()) {
+    Edge new_edge = {};
+    new_edge.weight_ = edges_[i]->weight_;
+    new_edge.src_ = forest.nodes_[edges_[i]->src_.lock()->index_];
+    new_edge.dest_ = forest.nodes_[edges_[i]->dest_.lock()->index_];
+    new_edge.src_.lock()->outdegree_++;
+    new_edge.dest_.lock()->indegree_++;
+    forest.edges_.push_back(forest.MakeEdge(new_edge));
+  }
+  forest.RebuildInEdges();
+  forest.RebuildDegreeIndex();
+  return forest;
 }
 
+// Label propagation: every node starts in its own community, then repeatedly joins the
+// community with the greatest total edge weight among its neighbours, keeping its own on a tie.
+// Sweeps are shared between threads in blocks of nodes, and labels are updated in place as
+// each node is visited (asynchronously), which converges faster than synchronous rounds and
+// avoids oscillating. Stops when a sweep changes nothing, or after max_iterations sweeps.
+// The refinement is the local moving phase of the Louvain method: nodes are moved, one at a
+// time, into the neighbouring community that most increases the modularity.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator
-gdwg::Graph<N, E>::find(const N& src, const N& dest, const E& weight) {
-  const_iterator it;
-  it.iterator_ = edges_.cbegin();
-  it.end_iterator_ = edges_.cend();
+typename gdwg::Graph<N, E>::Communities
+gdwg::Graph<N, E>::DetectCommunities(bool refine,
+                                     std::size_t max_iterations,
+                                     unsigned threads) const {
+  auto adjacency = MakeAdjacency(true);
+  const auto size = nodes_.size();
+  const auto& offsets = adjacency.offsets_;
+  const auto& targets = adjacency.targets_;
+  std::vector<double> weights(targets.size());
+  std::vector<double> degree(size, 0);
+  double total = 0;
+  for (std::size_t u = 0; u < size; ++u) {
+    for (auto k = offsets[u]; k < offsets[u + 1]; ++k) {
+      weights[k] = static_cast<double>(edges_[adjacency.positions_[k]]->weight_);
+      degree[u] += weights[k];
+    }
+    total += degree[u];
+  }
 
-  while (it.iterator_ != it.end_iterator_) {
-    auto node = *(it.iterator_);
-    if (node->src_.lock()->value_ == src && node->dest_.lock()->value_ == dest &&
-        node->weight_ == weight) {
+  std::vector<std::atomic<std::size_t>> shared_labels(size);
+  for (std::size_t u = 0; u < size; ++u) {
+    shared_labels[u].store(u, std::memory_order_relaxed);
+  }
+  // Below this many nodes per thread, starting threads costs more than it saves
+  constexpr std::size_t kMinNodesPerThread = 4096;
+  constexpr std::size_t kBlock = 256;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, size / kMinNodesPerThread + 1));
+  }
+  for (std::size_t iteration = 0; iteration < max_iterations; ++iteration) {
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> changed{0};
+    auto sweep = [&] {
+      std::vector<std::pair<std::size_t, double>> votes;
+      std::size_t changes = 0;
+      for (auto first = next.fetch_add(kBlock); first < size; first = next.fetch_add(kBlock)) {
+        for (auto u = first; u < std::min(first + kBlock, size); ++u) {
+          votes.clear();
+          for (auto k = offsets[u]; k < offsets[u + 1]; ++k) {
+            votes.emplace_back(shared_labels[targets[k]].load(std::memory_order_relaxed),
+                               weights[k]);
+          }
+          if (votes.empty()) {
+            continue;
+          }
+          std::sort(votes.begin(), votes.end());
+          auto current = shared_labels[u].load(std::memory_order_relaxed);
+          auto best = current;
+          double best_weight = -1;
+          double current_weight = -1;
+          for (std::size_t i = 0; i < votes.size();) {
+            auto label = votes[i].first;
+            double weight = 0;
+            for (; i < votes.size() && votes[i].first == label; ++i) {
+              weight += votes[i].second;
+            }
+            if (label == current) {
+              current_weight = weight;
+            }
+            if (weight > best_weight) {
+              best = label;
+              best_weight = weight;
+            }
+          }
+          if (best != current && best_weight > current_weight) {
+            shared_labels[u].store(best, std::memory_order_relaxed);
+            ++changes;
+          }
+        }
+      }
+      changed += changes;
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+      workers.emplace_back(sweep);
+    }
+    sweep();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    if (changed == 0) {
       break;
     }
-    ++it.iterator_;
   }
-  return it;
-}
+  std::vector<std::size_t> labels(size);
+  for (std::size_t u = 0; u < size; ++u) {
+    labels[u] = shared_labels[u].load(std::memory_order_relaxed);
+  }
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator
-gdwg::Graph<N, E>::find(const N& src, const N& dest, const E& weight) const {
-  const_iterator it;
-  it.iterator_ = edges_.cbegin();
-  it.end_iterator_ = edges_.cend();
+  if (refine && total > 0) {
+    std::vector<double> community_degree(size, 0);
+    for (std::size_t u = 0; u < size; ++u) {
+      community_degree[labels[u]] += degree[u];
+    }
+    std::vector<double> link(size, 0);
+    std::vector<bool> linked(size, false);
+    std::vector<std::size_t> neighbours;
+    for (std::size_t pass = 0; pass < max_iterations; ++pass) {
+      bool moved = false;
+      for (std::size_t u = 0; u < size; ++u) {
+        neighbours.clear();
+        for (auto k = offsets[u]; k < offsets[u + 1]; ++k) {
+          if (targets[k] == u) {
+            continue;
+          }
+          auto label = labels[targets[k]];
+          if (!linked[label]) {
+            linked[label] = true;
+            neighbours.push_back(label);
+          }
+          link[label] += weights[k];
+        }
+        // Take u out of its community, then put it back wherever the modularity gain is highest
+        auto current = labels[u];
+        community_degree[current] -= degree[u];
+        auto best = current;
+        double best_gain = link[current] - community_degree[current] * degree[u] / total;
+        for (auto label : neighbours) {
+          double gain = link[label] - community_degree[label] * degree[u] / total;
+          if (gain > best_gain + 1e-12) {
+            best = label;
+            best_gain = gain;
+          }
+        }
+        community_degree[best] += degree[u];
+        if (best != current) {
+          labels[u] = best;
+          moved = true;
+        }
+        for (auto label : neighbours) {
+          link[label] = 0;
+          linked[label] = false;
+        }
+      }
+      if (!moved) {
+        break;
+      }
+    }
+  }
 
-  while (it.iterator_ != it.end_iterator_) {
-    auto node = *(it.iterator_);
-    if (node->src_.lock()->value_ == src && node->dest_.lock()->value_ == dest &&
-        node->weight_ == weight) {
-      break;
+  // Modularity = sum over communities of (internal weight / 2m) - (community degree / 2m)^2
+  Communities communities;
+  if (total > 0) {
+    std::vector<double> internal(size, 0);
+    std::vector<double> community_degree(size, 0);
+    for (std::size_t u = 0; u < size; ++u) {
+      community_degree[labels[u]] += degree[u];
+      for (auto k = offsets[u]; k < offsets[u + 1]; ++k) {
+        if (labels[targets[k]] == labels[u]) {
+          internal[labels[u]] += weights[k];
+        }
+      }
+    }
+    for (std::size_t c = 0; c < size; ++c) {
+      communities.modularity_ += internal[c] / total - (community_degree[c] / total) *
+                                                           (community_degree[c] / total);
     }
-    ++it.iterator_;
   }
-  return it;
+
+  // Report the nodes in sorted order, with the labels renumbered from 0
+  std::vector<std::size_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+    return nodes_[a]->value_ < nodes_[b]->value_;
+  });
+  const auto unnumbered = size;
+  std::vector<std::size_t> numbering(size, unnumbered);
+  for (auto u : order) {
+    if (numbering[labels[u]] == unnumbered) {
+      numbering[labels[u]] = communities.count_++;
+    }
+    communities.nodes_.push_back(nodes_[u]->value_);
+    communities.labels_.push_back(numbering[labels[u]]);
+  }
+  return communities;
 }
 
+// FENNEL scores placing a node in a shard as the neighbours already there less
+// alpha * gamma * size^(gamma - 1), the marginal cost of growing the shard, with gamma = 1.5 and
+// alpha = sqrt(shards) * edges / nodes^1.5 as the paper suggests. Ties go to the smaller shard.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::erase(const_iterator old_it) {
-  if (old_it.iterator_ == old_it.end_iterator_ || *old_it.iterator_ == nullptr) {
-    return old_it;
+typename gdwg::Graph<N, E>::Partition
+gdwg::Graph<N, E>::PartitionNodes(std::size_t shards,
+                                  double imbalance,
+                                  std::size_t refinement_passes) const {
+  if (shards == 0 || !(imbalance >= 1)) {
+    throw std::runtime_error("Cannot call Graph::PartitionNodes without shards or with an "
+                             "imbalance below 1");
   }
-  N& erase_src = old_it.iterator_->get()->src_.lock()->value_;
-  N& erase_dest = old_it.iterator_->get()->dest_.lock()->value_;
-  E& erase_weight = old_it.iterator_->get()->weight_;
+  auto adjacency = MakeAdjacency(true);
+  const auto size = nodes_.size();
+  const auto& offsets = adjacency.offsets_;
+  const auto& targets = adjacency.targets_;
+  const auto unassigned = shards;
+  const auto mean = static_cast<double>(size) / static_cast<double>(shards);
+  // Rounded up, less a little so that 1.1 * 100 is 110 rather than 111
+  const auto capacity = std::max((size + shards - 1) / shards,
+                                 static_cast<std::size_t>(std::ceil(imbalance * mean - 1e-9)));
+  constexpr double kGamma = 1.5;
+  const double alpha = size == 0 ? 0
+                                 : std::sqrt(static_cast<double>(shards)) *
+                                       static_cast<double>(edges_.size()) /
+                                       std::pow(static_cast<double>(size), kGamma);
 
-  // If the iterator is pointing to the last element already, delete it and return end()
-  if ((old_it.iterator_ != old_it.end_iterator_) &&
-      (next(old_it.iterator_) == old_it.end_iterator_)) {
-    this->erase(erase_src, erase_dest, erase_weight);
-    return this->end();
+  Partition partition;
+  partition.shard_count_ = shards;
+  partition.shard_sizes_.assign(shards, 0);
+  auto& sizes = partition.shard_sizes_;
+  std::vector<std::size_t> shard_of(size, unassigned);
+  std::vector<std::size_t> neighbours(shards, 0);
+  auto count_neighbours = [&](std::size_t u) {
+    std::fill(neighbours.begin(), neighbours.end(), 0);
+    for (auto k = offsets[u]; k < offsets[u + 1]; ++k) {
+      if (targets[k] != u && shard_of[targets[k]] != unassigned) {
+        ++neighbours[shard_of[targets[k]]];
+      }
+    }
+  };
+  for (std::size_t u = 0; u < size; ++u) {
+    count_neighbours(u);
+    auto best = unassigned;
+    double best_score = 0;
+    for (std::size_t s = 0; s < shards; ++s) {
+      if (sizes[s] >= capacity) {
+        continue;
+      }
+      double score = static_cast<double>(neighbours[s]) -
+                     alpha * kGamma * std::pow(static_cast<double>(sizes[s]), kGamma - 1);
+      if (best == unassigned || score > best_score ||
+          (score == best_score && sizes[s] < sizes[best])) {
+        best = s;
+        best_score = score;
+      }
+    }
+    shard_of[u] = best;
+    ++sizes[best];
   }
 
-  ++old_it.iterator_;
-  N& new_src = old_it.iterator_->get()->src_.lock()->value_;
-  N& new_dest = old_it.iterator_->get()->dest_.lock()->value_;
-  E& new_weight = old_it.iterator_->get()->weight_;
-  bool deleted = this->erase(erase_src, erase_dest, erase_weight);
+  for (std::size_t pass = 0; pass < refinement_passes; ++pass) {
+    bool moved = false;
+    for (std::size_t u = 0; u < size; ++u) {
+      count_neighbours(u);
+      auto current = shard_of[u];
+      auto best = current;
+      for (std::size_t s = 0; s < shards; ++s) {
+        if (sizes[s] < capacity && neighbours[s] > neighbours[best]) {
+          best = s;
+        }
+      }
+      if (best != current) {
+        --sizes[current];
+        ++sizes[best];
+        shard_of[u] = best;
+        moved = true;
+      }
+    }
+    if (!moved) {
+      break;
+    }
+  }
 
-  // If no erase can be made, the equivalent of gdwg::Graph<N, E>::end() is returned.
-  if (deleted == false) {
-    return this->end();
+  for (const auto& [src, dest] : EdgeIndices()) {
+    if (shard_of[src] != shard_of[dest]) {
+      ++partition.edge_cut_;
+    }
   }
-  return this->find(new_src, new_dest, new_weight);
+  if (size > 0) {
+    partition.balance_ = static_cast<double>(*std::max_element(sizes.begin(), sizes.end())) / mean;
+  }
+  std::vector<std::size_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+    return nodes_[a]->value_ < nodes_[b]->value_;
+  });
+  for (auto u : order) {
+    partition.nodes_.push_back(nodes_[u]->value_);
+    partition.shards_.push_back(shard_of[u]);
+  }
+  return partition;
 }
 
+// The shard's nodes are added in sorted order, and its edges are a subsequence of edges_ and
+// in_edges_, so the shard graph needs no sorting.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_reverse_iterator& gdwg::Graph<N, E>::const_reverse_iterator::
-operator++() {
-  ++iterator_;
+typename gdwg::Graph<N, E>::Shard gdwg::Graph<N, E>::ExtractShard(const Partition& partition,
+                                                                  std::size_t shard) const {
+  if (shard >= partition.shard_count_) {
+    throw std::out_of_range("Cannot call Graph::ExtractShard if the shard doesn't exist in the "
+                            "partition");
+  }
+  if (transaction_ != nullptr) {
+    throw std::runtime_error("Cannot call Graph::ExtractShard while a transaction is open");
+  }
+  if (partition.nodes_.size() != nodes_.size()) {
+    throw std::runtime_error("Cannot call Graph::ExtractShard with a partition of another graph");
+  }
+  Shard result{Graph{GetMemoryResource()}, {}, {}};
+  auto& g = result.graph_;
+  const auto npos = nodes_.size();
+  // Walk this graph's nodes in sorted order, alongside the partition's
+  std::vector<std::size_t> order(nodes_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+    return nodes_[a]->value_ < nodes_[b]->value_;
+  });
+  // The index in g of each node in this graph, or npos if it's in another shard
+  std::vector<std::size_t> local(nodes_.size(), npos);
+  std::vector<bool> on_boundary(nodes_.size(), false);
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    const auto& node = nodes_[order[i]];
+    if (partition.nodes_[i] != node->value_) {
+      throw std::runtime_error("Cannot call Graph::ExtractShard with a partition of another "
+                               "graph");
+    }
+    if (partition.shards_[i] == shard) {
+      local[order[i]] = g.nodes_.size();
+      Node copy = {};
+      copy.value_ = node->value_;
+      g.AppendNode(copy);
+    }
+  }
+  for (const auto& edge : edges_) {
+    auto src = edge->src_.lock()->index_;
+    auto dest = edge->dest_.lock()->index_;
+    if (local[src] != npos && local[dest] != npos) {
+      Edge copy = {};
+      copy.weight_ = edge->weight_;
+      copy.src_ = g.nodes_[local[src]];
+      copy.dest_ = g.nodes_[local[dest]];
+      ++g.nodes_[local[src]]->outdegree_;
+      ++g.nodes_[local[dest]]->indegree_;
+      g.edges_.push_back(g.MakeEdge(copy));
+    } else if (local[src] != npos || local[dest] != npos) {
+      on_boundary[local[src] != npos ? src : dest] = true;
+      result.cut_edges_.emplace_back(edge->src_.lock()->value_, edge->dest_.lock()->value_,
+                                     edge->weight_);
+    }
+  }
+  g.RebuildInEdges();
+  g.RebuildDegreeIndex();
+  for (auto u : order) {
+    if (on_boundary[u]) {
+      result.boundary_.push_back(nodes_[u]->value_);
+    }
+  }
+  return result;
 }
 
+// frontier[u] has bit b set if u was first reached by batch seed b on the previous level, and
+// visited[u] if it has been reached by seed b at all.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_reverse_iterator& gdwg::Graph<N, E>::const_reverse_iterator::
-operator--() {
-  --iterator_;
-  return *this;
-}
+typename gdwg::Graph<N, E>::Neighbourhoods
+gdwg::Graph<N, E>::KHopNeighbourhoods(const std::vector<N>& seeds, std::size_t k) const {
+  constexpr std::size_t kBatch = 64;
+  const auto size = nodes_.size();
+  std::vector<std::size_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+    return nodes_[a]->value_ < nodes_[b]->value_;
+  });
+  std::vector<std::size_t> sources;
+  sources.reserve(seeds.size());
+  for (const auto& seed : seeds) {
+    auto found = std::lower_bound(order.begin(), order.end(), seed,
+                                  [this](std::size_t u, const N& value) {
+                                    return nodes_[u]->value_ < value;
+                                  });
+    if (found == order.end() || nodes_[*found]->value_ != seed) {
+      throw std::out_of_range("Cannot call Graph::KHopNeighbourhoods if a seed doesn't exist in "
+                              "the graph");
+    }
+    sources.push_back(*found);
+  }
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crbegin() noexcept {
-  const_reverse_iterator it;
-  it.iterator_ = edges_.crbegin();
-  it.end_iterator_ = edges_.crend();
-  return it;
+  auto adjacency = MakeAdjacency(false);
+  const auto& offsets = adjacency.offsets_;
+  const auto& targets = adjacency.targets_;
+  Neighbourhoods result;
+  result.offsets_.push_back(0);
+  std::vector<std::uint64_t> seeded(size);
+  std::vector<std::uint64_t> visited(size);
+  std::vector<std::uint64_t> frontier(size);
+  std::vector<std::uint64_t> next(size);
+  for (std::size_t first = 0; first < sources.size(); first += kBatch) {
+    const auto batch = std::min(kBatch, sources.size() - first);
+    std::fill(seeded.begin(), seeded.end(), 0);
+    for (std::size_t b = 0; b < batch; ++b) {
+      seeded[sources[first + b]] |= std::uint64_t{1} << b;
+    }
+    visited = seeded;
+    frontier = seeded;
+    for (std::size_t level = 0; level < k; ++level) {
+      std::fill(next.begin(), next.end(), 0);
+      bool reached = false;
+      for (std::size_t u = 0; u < size; ++u) {
+        if (frontier[u] == 0) {
+          continue;
+        }
+        for (auto e = offsets[u]; e < offsets[u + 1]; ++e) {
+          next[targets[e]] |= frontier[u];
+        }
+      }
+      for (std::size_t v = 0; v < size; ++v) {
+        next[v] &= ~visited[v];
+        visited[v] |= next[v];
+        reached = reached || next[v] != 0;
+      }
+      if (!reached) {
+        break;
+      }
+      frontier.swap(next);
+    }
+
+    // Count each seed's nodes, then fill them in sorted order
+    std::vector<std::size_t> counts(batch, 0);
+    for (std::size_t v = 0; v < size; ++v) {
+      auto reached = visited[v] & ~seeded[v];
+      for (std::size_t b = 0; reached != 0; ++b, reached >>= 1) {
+        counts[b] += reached & 1;
+      }
+    }
+    std::vector<std::size_t> fill;
+    for (std::size_t b = 0; b < batch; ++b) {
+      fill.push_back(result.offsets_.back());
+      result.offsets_.push_back(result.offsets_.back() + counts[b]);
+    }
+    result.nodes_.resize(result.offsets_.back());
+    for (auto v : order) {
+      auto reached = visited[v] & ~seeded[v];
+      for (std::size_t b = 0; reached != 0; ++b, reached >>= 1) {
+        if ((reached & 1) != 0) {
+          result.nodes_[fill[b]++] = nodes_[v]->value_;
+        }
+      }
+    }
+  }
+  return result;
 }
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crend() noexcept {
-  const_reverse_iterator it;
-  it.iterator_ = edges_.crend();
-  it.end_iterator_ = edges_.crend();
-  return it;
+/************** EXTERNAL MEMORY ******************/
+// A CSR file holds, in native byte order:
+//   the magic "GDWGCSR1", then sizeof(N), sizeof(E), the node count n and the edge count m as
+//   std::uint64_t; the n node values in ascending order; n + 1 std::uint64_t offsets; m
+//   std::uint64_t destination node indices; and m weights.
+// The edges leaving node i are offsets[i] up to offsets[i + 1], sorted as edges_ is.
+namespace gdwg::csr {
+
+constexpr char kMagic[8] = {'G', 'D', 'W', 'G', 'C', 'S', 'R', '1'};
+
+template <typename T>
+void Write(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
 }
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crbegin() const noexcept {
-  const_reverse_iterator it;
-  it.iterator_ = edges_.crbegin();
-  it.end_iterator_ = edges_.crend();
-  return it;
+template <typename T>
+bool Read(std::istream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
 }
 
+}  // namespace gdwg::csr
+
+// Ingestion runs as a pipeline of external sorts, so that no phase needs more than two sorters'
+// buffers, half the budget each, in memory:
+//  1. Each line is pushed to a sorter of edges, by (src, dst, weight), and its src and dst to a
+//     sorter of nodes.
+//  2. The merged nodes, without duplicates, are written out as the node section.
+//  3. The merged edges, without duplicates, are walked alongside the node section to write the
+//     offsets and the weights. Each edge's dst and position go to a sorter by dst.
+//  4. Those are walked alongside the node section again to find the index of each dst, and
+//     each position and index go to a sorter by position.
+//  5. That yields the indices in edge order, which are written out as the target section.
+// The sections are written to their own files, then concatenated behind the header.
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crend() const noexcept {
-  const_reverse_iterator it;
-  it.iterator_ = edges_.crend();
-  it.end_iterator_ = edges_.crend();
-  return it;
+typename gdwg::Graph<N, E>::IngestStats
+gdwg::Graph<N, E>::IngestEdgeList(const std::string& edge_list_path,
+                                  const std::string& csr_path,
+                                  std::size_t memory_budget) {
+  static_assert(std::is_trivially_copyable_v<N> && std::is_trivially_copyable_v<E>,
+                "Graph::IngestEdgeList writes nodes and weights to disk as raw bytes");
+  struct EdgeRecord {
+    N src_;
+    N dest_;
+    E weight_;
+  };
+  struct Link {
+    N dest_;
+    std::uint64_t position_;
+  };
+  struct Target {
+    std::uint64_t position_;
+    std::uint64_t index_;
+  };
+  auto by_edge = [](const EdgeRecord& a, const EdgeRecord& b) {
+    return std::tie(a.src_, a.dest_, a.weight_) < std::tie(b.src_, b.dest_, b.weight_);
+  };
+  auto by_dest = [](const Link& a, const Link& b) { return a.dest_ < b.dest_; };
+  auto by_position = [](const Target& a, const Target& b) { return a.position_ < b.position_; };
+  using EdgeSorter = ExternalSorter<EdgeRecord, decltype(by_edge)>;
+  using NodeSorter = ExternalSorter<N, std::less<N>>;
+  using LinkSorter = ExternalSorter<Link, decltype(by_dest)>;
+  using TargetSorter = ExternalSorter<Target, decltype(by_position)>;
+
+  // Removes the section files however ingestion ends
+  struct Sections {
+    ~Sections() {
+      for (const auto& path : paths_) {
+        std::remove(path.c_str());
+      }
+    }
+    std::vector<std::string> paths_;
+  } sections;
+  for (const auto* name : {".nodes", ".offsets", ".targets", ".weights"}) {
+    sections.paths_.push_back(csr_path + name);
+  }
+  auto open_output = [](const std::string& path) {
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out) {
+      throw std::runtime_error("Cannot call Graph::IngestEdgeList if " + path +
+                               " can't be written");
+    }
+    return out;
+  };
+  auto open_input = [](const std::string& path, std::ios::openmode mode) {
+    std::ifstream in{path, mode};
+    if (!in) {
+      throw std::runtime_error("Cannot call Graph::IngestEdgeList if " + path +
+                               " can't be read");
+    }
+    return in;
+  };
+  auto check = [](const std::ostream& out, const std::string& path) {
+    if (!out) {
+      throw std::runtime_error("Cannot call Graph::IngestEdgeList if " + path +
+                               " can't be written");
+    }
+  };
+
+  IngestStats stats;
+  std::optional<EdgeSorter> edges;
+  edges.emplace(csr_path + ".edge_run", memory_budget / 2, by_edge);
+  {
+    NodeSorter nodes{csr_path + ".node_run", memory_budget / 2, std::less<N>{}};
+    auto input = open_input(edge_list_path, std::ios::in);
+    std::string line;
+    for (std::size_t number = 1; std::getline(input, line); ++number) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        continue;
+      }
+      std::istringstream fields{line};
+      EdgeRecord record{};
+      if (!(fields >> record.src_ >> record.dest_ >> record.weight_)) {
+        throw std::runtime_error("Cannot call Graph::IngestEdgeList if line " +
+                                 std::to_string(number) + " of " + edge_list_path +
+                                 " isn't \"src dst weight\"");
+      }
+      edges->Push(record);
+      nodes.Push(record.src_);
+      nodes.Push(record.dest_);
+    }
+
+    nodes.Finish();
+    auto out = open_output(sections.paths_[0]);
+    N node;
+    std::optional<N> previous;
+    while (nodes.Next(node)) {
+      if (!previous || *previous < node) {
+        csr::Write(out, node);
+        previous = node;
+        ++stats.nodes_;
+      }
+    }
+    check(out, sections.paths_[0]);
+    stats.runs_ += nodes.Spilled();
+  }
+
+  std::optional<LinkSorter> links;
+  links.emplace(csr_path + ".link_run", memory_budget / 2, by_dest);
+  {
+    edges->Finish();
+    auto node_section = open_input(sections.paths_[0], std::ios::binary);
+    auto offsets = open_output(sections.paths_[1]);
+    auto weights = open_output(sections.paths_[3]);
+    std::uint64_t position = 0;
+    csr::Write(offsets, position);
+    // node is the finished'th node, the first whose edges haven't all been seen
+    std::size_t finished = 0;
+    N node{};
+    csr::Read(node_section, node);
+    EdgeRecord record;
+    std::optional<EdgeRecord> previous;
+    while (edges->Next(record)) {
+      if (previous && !by_edge(*previous, record)) {
+        continue;
+      }
+      previous = record;
+      // Every src is a node, so this stops at it
+      while (node < record.src_) {
+        csr::Write(offsets, position);
+        ++finished;
+        csr::Read(node_section, node);
+      }
+      csr::Write(weights, record.weight_);
+      links->Push(Link{record.dest_, position++});
+    }
+    for (; finished < stats.nodes_; ++finished) {
+      csr::Write(offsets, position);
+    }
+    check(offsets, sections.paths_[1]);
+    check(weights, sections.paths_[3]);
+    stats.edges_ = position;
+    stats.runs_ += edges->Spilled();
+    edges.reset();
+  }
+
+  {
+    TargetSorter targets{csr_path + ".target_run", memory_budget / 2, by_position};
+    links->Finish();
+    auto node_section = open_input(sections.paths_[0], std::ios::binary);
+    std::uint64_t index = 0;
+    N node{};
+    bool loaded = csr::Read(node_section, node);
+    Link link;
+    while (links->Next(link)) {
+      while (loaded && node < link.dest_) {
+        loaded = csr::Read(node_section, node);
+        ++index;
+      }
+      targets.Push(Target{link.position_, index});
+    }
+    stats.runs_ += links->Spilled();
+    links.reset();
+
+    targets.Finish();
+    auto out = open_output(sections.paths_[2]);
+    Target target;
+    while (targets.Next(target)) {
+      csr::Write(out, target.index_);
+    }
+    check(out, sections.paths_[2]);
+    stats.runs_ += targets.Spilled();
+  }
+
+  auto out = open_output(csr_path);
+  out.write(csr::kMagic, sizeof(csr::kMagic));
+  for (std::uint64_t field : {std::uint64_t{sizeof(N)}, std::uint64_t{sizeof(E)},
+                              std::uint64_t{stats.nodes_}, std::uint64_t{stats.edges_}}) {
+    csr::Write(out, field);
+  }
+  for (const auto& path : sections.paths_) {
+    auto in = open_input(path, std::ios::binary);
+    // An empty section would set failbit on out
+    if (in.peek() != std::ifstream::traits_type::eof()) {
+      out << in.rdbuf();
+    }
+  }
+  check(out, csr_path);
+  return stats;
+}
+
+// Nodes are appended in the file's (sorted) order and the edges are already in edges_ order,
+// so nothing needs sorting; a file out of order is malformed.
+template <typename N, typename E>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::LoadCsr(const std::string& csr_path,
+                                             std::pmr::memory_resource* resource) {
+  static_assert(std::is_trivially_copyable_v<N> && std::is_trivially_copyable_v<E>,
+                "Graph::LoadCsr reads nodes and weights from disk as raw bytes");
+  auto malformed = [&csr_path] {
+    return std::runtime_error("Cannot call Graph::LoadCsr if " + csr_path +
+                              " isn't a CSR file of this graph's types");
+  };
+  std::ifstream in{csr_path, std::ios::binary};
+  if (!in) {
+    throw std::runtime_error("Cannot call Graph::LoadCsr if " + csr_path + " can't be read");
+  }
+  char magic[sizeof(csr::kMagic)];
+  std::uint64_t node_size = 0;
+  std::uint64_t edge_size = 0;
+  std::uint64_t node_count = 0;
+  std::uint64_t edge_count = 0;
+  if (!csr::Read(in, magic) || !std::equal(magic, magic + sizeof(magic), csr::kMagic) ||
+      !csr::Read(in, node_size) || !csr::Read(in, edge_size) || node_size != sizeof(N) ||
+      edge_size != sizeof(E) || !csr::Read(in, node_count) || !csr::Read(in, edge_count)) {
+    throw malformed();
+  }
+  // Each node takes at least its value and offset, and each edge its target and weight, so the
+  // counts are bounded by the bytes left before anything is reserved
+  auto header_end = in.tellg();
+  in.seekg(0, std::ios::end);
+  auto remaining = static_cast<std::uint64_t>(in.tellg() - header_end);
+  in.seekg(header_end);
+  if (!in || node_count > remaining / (sizeof(N) + sizeof(std::uint64_t)) ||
+      edge_count > remaining / (sizeof(E) + sizeof(std::uint64_t))) {
+    throw malformed();
+  }
+
+  Graph g{resource};
+  g.nodes_.reserve(node_count);
+  for (std::uint64_t i = 0; i < node_count; ++i) {
+    Node node = {};
+    if (!csr::Read(in, node.value_) || (i > 0 && !(g.nodes_.back()->value_ < node.value_))) {
+      throw malformed();
+    }
+    g.AppendNode(node);
+  }
+  std::vector<std::uint64_t> offsets(node_count + 1);
+  std::vector<std::uint64_t> targets(edge_count);
+  if (!in.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(std::uint64_t)) ||
+      !in.read(reinterpret_cast<char*>(targets.data()), targets.size() * sizeof(std::uint64_t)) ||
+      offsets.front() != 0 || offsets.back() != edge_count ||
+      !std::is_sorted(offsets.begin(), offsets.end())) {
+    throw malformed();
+  }
+  g.edges_.reserve(edge_count);
+  for (std::uint64_t src = 0; src < node_count; ++src) {
+    for (auto k = offsets[src]; k < offsets[src + 1]; ++k) {
+      Edge edge = {};
+      if (targets[k] >= node_count || !csr::Read(in, edge.weight_)) {
+        throw malformed();
+      }
+      // Within a source, edges must be in (target, weight) order with no repeats
+      if (k > offsets[src] &&
+          (targets[k] < targets[k - 1] ||
+           (targets[k] == targets[k - 1] && !(g.edges_.back()->weight_ < edge.weight_)))) {
+        throw malformed();
+      }
+      edge.src_ = g.nodes_[src];
+      edge.dest_ = g.nodes_[targets[k]];
+      ++g.nodes_[src]->outdegree_;
+      ++g.nodes_[targets[k]]->indegree_;
+      g.edges_.push_back(g.MakeEdge(edge));
+    }
+  }
+  g.RebuildInEdges();
+  g.RebuildDegreeIndex();
+  return g;
+}
+
+namespace gdwg::text {
+
+// A read-only mapping of a whole file, unmapped when destroyed. An empty file maps to an empty
+// view, as mmap refuses a length of 0.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    descriptor_ = ::open(path.c_str(), O_RDONLY);
+    struct stat status = {};
+    if (descriptor_ < 0 || ::fstat(descriptor_, &status) != 0) {
+      Close();
+      throw std::runtime_error("Cannot call Graph::ParseEdgeList if " + path + " can't be read");
+    }
+    size_ = static_cast<std::size_t>(status.st_size);
+    if (size_ > 0) {
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor_, 0);
+      if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        Close();
+        throw std::runtime_error("Cannot call Graph::ParseEdgeList if " + path +
+                                 " can't be mapped");
+      }
+      ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+
+  std::string_view View() const noexcept {
+    return data_ == nullptr ? std::string_view{}
+                            : std::string_view{static_cast<const char*>(data_), size_};
+  }
+
+ private:
+  void Close() noexcept {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+    if (descriptor_ >= 0) {
+      ::close(descriptor_);
+    }
+  }
+
+  int descriptor_ = -1;
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Parses all of field into value, returning whether it was valid
+template <typename T>
+bool Parse(std::string_view field, T& value) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+    return error == std::errc{} && end == field.data() + field.size();
+  } else {
+    static_assert(std::is_constructible_v<T, std::string_view>,
+                  "Graph::ParseEdgeList needs nodes that are arithmetic or made from text");
+    value = T{field};
+    return true;
+  }
+}
+
+}  // namespace gdwg::text
+
+// Parsing happens in three steps:
+//  1. Each thread parses the lines that start in its chunk. It interns the names it sees as
+//     views into the mapped file, numbered locally, and keeps each edge as two local numbers.
+//  2. Every chunk's names are converted to N, sorted and deduplicated into the node list, so
+//     a node's index is its rank. Each chunk's local numbers are mapped to indices.
+//  3. The edges are sorted by (src index, dst index, weight), which is CompareSort order, and
+//     deduplicated, then the nodes and edges are allocated in order.
+template <typename N, typename E>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::ParseEdgeList(const std::string& path,
+                                                   unsigned threads,
+                                                   std::pmr::memory_resource* resource) {
+  static_assert(std::is_arithmetic_v<E>, "Graph::ParseEdgeList needs arithmetic weights");
+  text::MappedFile file{path};
+  const auto data = file.View();
+  struct IndexedEdge {
+    std::size_t src_;
+    std::size_t dest_;
+    E weight_;
+  };
+  struct Chunk {
+    std::string_view text_;
+    std::vector<std::string_view> names_;
+    std::vector<IndexedEdge> edges_;
+    // Where the first bad line starts in the file, if there is one
+    std::optional<std::size_t> error_;
+  };
+
+  // Below this many bytes per thread, starting threads costs more than it saves
+  constexpr std::size_t kMinChunk = std::size_t{1} << 20;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, data.size() / kMinChunk + 1));
+  }
+  std::vector<Chunk> chunks(threads);
+  std::size_t begin = 0;
+  for (unsigned t = 0; t < threads; ++t) {
+    auto end = t + 1 == threads ? data.size() : data.size() / threads * (t + 1);
+    // Extend the chunk to the end of the line it stops in
+    end = std::max(begin, end);
+    if (end < data.size() && end > 0 && data[end - 1] != '\n') {
+      auto newline = data.find('\n', end);
+      end = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+    chunks[t].text_ = data.substr(begin, end - begin);
+    begin = end;
+  }
+
+  auto parse = [&data](Chunk& chunk) {
+    std::unordered_map<std::string_view, std::size_t> ids;
+    auto intern = [&](std::string_view name) {
+      auto [it, inserted] = ids.emplace(name, chunk.names_.size());
+      if (inserted) {
+        chunk.names_.push_back(name);
+      }
+      return it->second;
+    };
+    auto text = chunk.text_;
+    while (!text.empty()) {
+      auto newline = text.find('\n');
+      auto line = text.substr(0, newline);
+      text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+      std::string_view fields[3];
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < line.size();) {
+        auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+        if (is_space(line[i])) {
+          ++i;
+          continue;
+        }
+        auto start = i;
+        while (i < line.size() && !is_space(line[i])) {
+          ++i;
+        }
+        if (count == 3) {
+          count = 4;
+          break;
+        }
+        fields[count++] = line.substr(start, i - start);
+      }
+      if (count == 0) {
+        continue;
+      }
+      IndexedEdge edge = {};
+      bool valid = count == 3 && text::Parse(fields[2], edge.weight_);
+      if constexpr (std::is_arithmetic_v<N>) {
+        // Names are only converted to N once interned, but numbers must be checked here
+        N unused = {};
+        valid = valid && text::Parse(fields[0], unused) && text::Parse(fields[1], unused);
+      }
+      if (!valid) {
+        chunk.error_ = static_cast<std::size_t>(line.data() - data.data());
+        return;
+      }
+      edge.src_ = intern(fields[0]);
+      edge.dest_ = intern(fields[1]);
+      chunk.edges_.push_back(edge);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < threads; ++t) {
+    workers.emplace_back(parse, std::ref(chunks[t]));
+  }
+  parse(chunks[0]);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (const auto& chunk : chunks) {
+    if (chunk.error_) {
+      auto line = std::count(data.begin(), data.begin() + *chunk.error_, '\n') + 1;
+      throw std::runtime_error("Cannot call Graph::ParseEdgeList if line " +
+                               std::to_string(line) + " of " + path +
+                               " isn't \"src dst weight\"");
+    }
+  }
+
+  // Numbers written differently, such as 7 and 07, are only found to be equal as N
+  std::vector<std::vector<N>> values(chunks.size());
+  std::vector<N> nodes;
+  for (std::size_t c = 0; c < chunks.size(); ++c) {
+    for (auto name : chunks[c].names_) {
+      text::Parse(name, values[c].emplace_back());
+    }
+    nodes.insert(nodes.end(), values[c].begin(), values[c].end());
+  }
+  std::sort(nodes.begin(), nodes.end());
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+  std::vector<IndexedEdge> edges;
+  for (std::size_t c = 0; c < chunks.size(); ++c) {
+    auto& chunk = chunks[c];
+    std::vector<std::size_t> index;
+    for (const auto& value : values[c]) {
+      index.push_back(std::lower_bound(nodes.begin(), nodes.end(), value) - nodes.begin());
+    }
+    values[c] = {};
+    for (const auto& edge : chunk.edges_) {
+      edges.push_back(IndexedEdge{index[edge.src_], index[edge.dest_], edge.weight_});
+    }
+    chunk.edges_ = {};
+  }
+  auto by_edge = [](const IndexedEdge& a, const IndexedEdge& b) {
+    return std::tie(a.src_, a.dest_, a.weight_) < std::tie(b.src_, b.dest_, b.weight_);
+  };
+  std::sort(edges.begin(), edges.end(), by_edge);
+  edges.erase(std::unique(edges.begin(), edges.end(),
+                          [&by_edge](const IndexedEdge& a, const IndexedEdge& b) {
+                            return !by_edge(a, b) && !by_edge(b, a);
+                          }),
+              edges.end());
+
+  Graph g{resource};
+  g.nodes_.reserve(nodes.size());
+  for (auto& value : nodes) {
+    Node node = {};
+    node.value_ = std::move(value);
+    g.AppendNode(node);
+  }
+  g.edges_.reserve(edges.size());
+  for (const auto& indexed : edges) {
+    Edge edge = {};
+    edge.weight_ = indexed.weight_;
+    edge.src_ = g.nodes_[indexed.src_];
+    edge.dest_ = g.nodes_[indexed.dest_];
+    ++g.nodes_[indexed.src_]->outdegree_;
+    ++g.nodes_[indexed.dest_]->indegree_;
+    g.edges_.push_back(g.MakeEdge(edge));
+  }
+  g.RebuildInEdges();
+  g.RebuildDegreeIndex();
+  return g;
+}
+
+template <typename N, typename E>
+template <typename Record, typename Compare>
+gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::ExternalSorter(std::string prefix,
+                                                                   std::size_t memory_budget,
+                                                                   Compare compare)
+  : prefix_{std::move(prefix)}, capacity_{std::max<std::size_t>(1, memory_budget / sizeof(Record))},
+    compare_{compare} {}
+
+template <typename N, typename E>
+template <typename Record, typename Compare>
+gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::~ExternalSorter() {
+  inputs_.clear();
+  for (const auto& run : runs_) {
+    std::remove(run.c_str());
+  }
+}
+
+template <typename N, typename E>
+template <typename Record, typename Compare>
+void gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::Push(const Record& record) {
+  buffer_.push_back(record);
+  if (buffer_.size() >= capacity_) {
+    Spill();
+  }
+}
+
+template <typename N, typename E>
+template <typename Record, typename Compare>
+void gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::Spill() {
+  std::sort(buffer_.begin(), buffer_.end(), compare_);
+  runs_.push_back(prefix_ + "." + std::to_string(spilled_++));
+  std::ofstream out{runs_.back(), std::ios::binary | std::ios::trunc};
+  out.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size() * sizeof(Record));
+  if (!out) {
+    throw std::runtime_error("Cannot call Graph::IngestEdgeList if " + runs_.back() +
+                             " can't be written");
+  }
+  buffer_.clear();
+}
+
+// Merges runs until at most kMaxFanIn are left, then opens those for Next()
+template <typename N, typename E>
+template <typename Record, typename Compare>
+void gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::Finish() {
+  if (runs_.empty()) {
+    std::sort(buffer_.begin(), buffer_.end(), compare_);
+    return;
+  }
+  if (!buffer_.empty()) {
+    Spill();
+  }
+  buffer_.clear();
+  buffer_.shrink_to_fit();
+  while (runs_.size() > kMaxFanIn) {
+    Open(kMaxFanIn);
+    runs_.push_back(prefix_ + "." + std::to_string(spilled_++));
+    std::ofstream out{runs_.back(), std::ios::binary | std::ios::trunc};
+    Record record;
+    while (Next(record)) {
+      csr::Write(out, record);
+    }
+    if (!out) {
+      throw std::runtime_error("Cannot call Graph::IngestEdgeList if " + runs_.back() +
+                               " can't be written");
+    }
+    inputs_.clear();
+    for (std::size_t i = 0; i < kMaxFanIn; ++i) {
+      std::remove(runs_[i].c_str());
+    }
+    runs_.erase(runs_.begin(), runs_.begin() + kMaxFanIn);
+  }
+  Open(runs_.size());
+}
+
+// Opens the first count runs and loads the heap with the head of each
+template <typename N, typename E>
+template <typename Record, typename Compare>
+void gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::Open(std::size_t count) {
+  inputs_.clear();
+  heap_.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    inputs_.emplace_back(runs_[i], std::ios::binary);
+    if (!inputs_.back()) {
+      throw std::runtime_error("Cannot call Graph::IngestEdgeList if " + runs_[i] +
+                               " can't be read");
+    }
+    Record record;
+    if (csr::Read(inputs_.back(), record)) {
+      heap_.emplace_back(record, i);
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(), [this](const auto& a, const auto& b) {
+    return compare_(b.first, a.first);
+  });
+}
+
+template <typename N, typename E>
+template <typename Record, typename Compare>
+bool gdwg::Graph<N, E>::ExternalSorter<Record, Compare>::Next(Record& record) {
+  if (runs_.empty()) {
+    if (position_ == buffer_.size()) {
+      return false;
+    }
+    record = buffer_[position_++];
+    return true;
+  }
+  if (heap_.empty()) {
+    return false;
+  }
+  auto later = [this](const auto& a, const auto& b) { return compare_(b.first, a.first); };
+  std::pop_heap(heap_.begin(), heap_.end(), later);
+  record = heap_.back().first;
+  auto source = heap_.back().second;
+  if (csr::Read(inputs_[source], heap_.back().first)) {
+    std::push_heap(heap_.begin(), heap_.end(), later);
+  } else {
+    heap_.pop_back();
+  }
+  return true;
+}
+
+template <typename N, typename E>
+gdwg::Graph<N, E>::DisjointSet::DisjointSet(std::size_t count) : parent_(count), size_(count, 1) {
+  std::iota(parent_.begin(), parent_.end(), 0);
+}
+
+// Returns the representative of the set holding x, halving the path to it on the way.
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::DisjointSet::Find(std::size_t x) noexcept {
+  while (parent_[x] != x) {
+    parent_[x] = parent_[parent_[x]];
+    x = parent_[x];
+  }
+  return x;
+}
+
+// Merges the sets holding a and b. Returns false if they were already the same set.
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::DisjointSet::Union(std::size_t a, std::size_t b) noexcept {
+  a = Find(a);
+  b = Find(b);
+  if (a == b) {
+    return false;
+  }
+  if (size_[a] < size_[b]) {
+    std::swap(a, b);
+  }
+  parent_[b] = a;
+  size_[a] += size_[b];
+  return true;
+}
+
+// Returns the index_ of the source and destination node of every edge, in edges_ order.
+template <typename N, typename E>
+std::vector<std::pair<std::size_t, std::size_t>> gdwg::Graph<N, E>::EdgeIndices() const {
+  std::vector<std::pair<std::size_t, std::size_t>> ends;
+  ends.reserve(edges_.size());
+  for (const auto& edge : edges_) {
+    ends.emplace_back(edge->src_.lock()->index_, edge->dest_.lock()->index_);
+  }
+  return ends;
+}
+
+// Builds the adjacency of every node with a counting sort over edges_. When undirected, each
+// edge is also listed as a neighbour of its destination, so a self edge is listed twice.
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::Adjacency gdwg::Graph<N, E>::MakeAdjacency(bool undirected) const {
+  auto ends = EdgeIndices();
+  Adjacency adjacency;
+  adjacency.offsets_.assign(nodes_.size() + 1, 0);
+  for (const auto& [src, dest] : ends) {
+    ++adjacency.offsets_[src + 1];
+    if (undirected) {
+      ++adjacency.offsets_[dest + 1];
+    }
+  }
+  std::partial_sum(adjacency.offsets_.begin(), adjacency.offsets_.end(),
+                   adjacency.offsets_.begin());
+  adjacency.targets_.resize(adjacency.offsets_.back());
+  adjacency.positions_.resize(adjacency.offsets_.back());
+  std::vector<std::size_t> fill(adjacency.offsets_.begin(), adjacency.offsets_.end() - 1);
+  for (std::size_t i = 0; i < ends.size(); ++i) {
+    const auto& [src, dest] = ends[i];
+    adjacency.targets_[fill[src]] = dest;
+    adjacency.positions_[fill[src]++] = i;
+    if (undirected) {
+      adjacency.targets_[fill[dest]] = src;
+      adjacency.positions_[fill[dest]++] = i;
+    }
+  }
+  return adjacency;
+}
+
+// Orders the edges at positions a and b by weight, then by position.
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::LighterEdge(std::size_t a, std::size_t b) const {
+  if (edges_[a]->weight_ < edges_[b]->weight_) {
+    return true;
+  }
+  if (edges_[b]->weight_ < edges_[a]->weight_) {
+    return false;
+  }
+  return a < b;
+}
+
+// Sorts positions with less, splitting large inputs into one chunk per hardware thread.
+// The chunks are sorted concurrently and then merged pairwise.
+template <typename N, typename E>
+template <typename Compare>
+void gdwg::Graph<N, E>::ParallelSort(std::vector<std::size_t>& positions, Compare less) {
+  // Below this many elements per chunk, starting threads costs more than it saves
+  constexpr std::size_t kMinChunk = 1 << 14;
+  std::size_t chunks = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                             positions.size() / kMinChunk);
+  if (chunks <= 1) {
+    std::sort(positions.begin(), positions.end(), less);
+    return;
+  }
+  std::vector<std::size_t> bounds;
+  for (std::size_t c = 0; c <= chunks; ++c) {
+    bounds.push_back(positions.size() * c / chunks);
+  }
+  std::vector<std::thread> workers;
+  for (std::size_t c = 0; c < chunks; ++c) {
+    workers.emplace_back([&positions, &bounds, less, c] {
+      std::sort(positions.begin() + bounds[c], positions.begin() + bounds[c + 1], less);
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (std::size_t width = 1; width < chunks; width *= 2) {
+    for (std::size_t c = 0; c + width < chunks; c += 2 * width) {
+      std::inplace_merge(positions.begin() + bounds[c], positions.begin() + bounds[c + width],
+                         positions.begin() + bounds[std::min(c + 2 * width, chunks)], less);
+    }
+  }
+}
+
+/************** CHANGE LOG ******************/
+// Starts recording deltas. Does nothing if the change log is already enabled.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::EnableChangeLog() {
+  if (change_log_ == nullptr) {
+    change_log_ = std::make_unique<ChangeLog>();
+  }
+}
+
+// Stops recording deltas, discarding every recorded delta and subscriber.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::DisableChangeLog() noexcept {
+  change_log_.reset();
+}
+
+// Returns the sequence number of the latest delta, or 0 if none has been recorded.
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::ChangeSequence() const noexcept {
+  if (change_log_ == nullptr) {
+    return 0;
+  }
+  return change_log_->first_sequence_ + change_log_->deltas_.size() - 1;
+}
+
+// Returns every delta with a sequence number after sequence, oldest first. As sequence numbers
+// are contiguous the first one is found by position, so this costs time proportional to the
+// number of deltas returned.
+// Throws a std::runtime_error if the change log is disabled, and a std::out_of_range exception
+// if some of the requested deltas have already been trimmed.
+template <typename N, typename E>
+std::vector<typename gdwg::Graph<N, E>::Delta>
+gdwg::Graph<N, E>::DeltasSince(std::uint64_t sequence) const {
+  if (change_log_ == nullptr) {
+    throw std::runtime_error("Cannot call Graph::DeltasSince when the change log is disabled");
+  }
+  if (sequence + 1 < change_log_->first_sequence_) {
+    throw std::out_of_range("Cannot call Graph::DeltasSince for deltas that "
+                            "have been trimmed from the change log");
+  }
+  if (sequence >= ChangeSequence()) {
+    return {};
+  }
+  auto first = change_log_->deltas_.cbegin() + (sequence + 1 - change_log_->first_sequence_);
+  return std::vector<Delta>(first, change_log_->deltas_.cend());
+}
+
+// Discards every delta up to and including sequence, once all consumers have read them.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::TrimChangeLog(std::uint64_t sequence) noexcept {
+  if (change_log_ == nullptr) {
+    return;
+  }
+  auto& deltas = change_log_->deltas_;
+  while (!deltas.empty() && deltas.front().sequence_ <= sequence) {
+    deltas.pop_front();
+    ++change_log_->first_sequence_;
+  }
+}
+
+// Calls callback with every delta recorded from now on, enabling the change log if needed.
+// Returns an id that can be passed to Unsubscribe.
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::Subscribe(std::function<void(const Delta&)> callback) {
+  EnableChangeLog();
+  auto id = change_log_->next_subscriber_++;
+  change_log_->subscribers_.emplace_back(id, std::move(callback));
+  return id;
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Unsubscribe(std::size_t id) noexcept {
+  if (change_log_ == nullptr) {
+    return;
+  }
+  auto& subscribers = change_log_->subscribers_;
+  subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                   [id](const auto& subscriber) { return subscriber.first == id; }),
+                    subscribers.end());
+}
+
+// Replays delta onto this graph by calling the method that produced it.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::ApplyDelta(const Delta& delta) {
+  switch (delta.kind_) {
+    case Delta::Kind::kInsertNode:
+      InsertNode(delta.node_);
+      break;
+    case Delta::Kind::kInsertEdge:
+      InsertEdge(delta.node_, *delta.other_, *delta.weight_);
+      break;
+    case Delta::Kind::kDeleteNode:
+      DeleteNode(delta.node_);
+      break;
+    case Delta::Kind::kEraseEdge:
+      erase(delta.node_, *delta.other_, *delta.weight_);
+      break;
+    case Delta::Kind::kReplace:
+      Replace(delta.node_, *delta.other_);
+      break;
+    case Delta::Kind::kMergeReplace:
+      MergeReplace(delta.node_, *delta.other_);
+      break;
+    case Delta::Kind::kClear:
+      clear();
+      break;
+  }
+}
+
+// Records a delta if the change log is enabled. Inside a transaction it is held back until the
+// transaction commits. Takes pointers so that nothing is copied while the log is disabled.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Log(typename Delta::Kind kind,
+                            const N& node,
+                            const N* other,
+                            const E* weight) {
+  if (change_log_ == nullptr) {
+    return;
+  }
+  Delta delta{kind, 0, node, std::nullopt, std::nullopt};
+  if (other != nullptr) {
+    delta.other_ = *other;
+  }
+  if (weight != nullptr) {
+    delta.weight_ = *weight;
+  }
+  if (transaction_ != nullptr) {
+    transaction_->deltas_.push_back(std::move(delta));
+  } else {
+    Publish(std::move(delta));
+  }
+}
+
+// Gives delta the next sequence number, appends it to the change log and notifies subscribers.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Publish(Delta&& delta) {
+  if (change_log_ == nullptr) {
+    return;
+  }
+  delta.sequence_ = ChangeSequence() + 1;
+  change_log_->deltas_.push_back(std::move(delta));
+  for (const auto& subscriber : change_log_->subscribers_) {
+    subscriber.second(change_log_->deltas_.back());
+  }
+}
+
+/************** DIFFS ******************/
+// Applies patch, as returned by Diff(*this, to), so that this graph becomes equal to to.
+// Edges are removed before the nodes they touch and added after them. Unless a transaction is
+// already open, the patch is applied in its own transaction, so it is all or nothing and the
+// edges are only sorted once.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::ApplyPatch(const Patch& patch) {
+  std::optional<Transaction> tx;
+  if (transaction_ == nullptr) {
+    tx.emplace(*this);
+  }
+  for (const auto& [src, dest, weight] : patch.removed_edges_) {
+    erase(src, dest, weight);
+  }
+  for (const auto& node : patch.removed_nodes_) {
+    DeleteNode(node);
+  }
+  for (const auto& node : patch.added_nodes_) {
+    InsertNode(node);
+  }
+  for (const auto& [src, dest, weight] : patch.added_edges_) {
+    InsertEdge(src, dest, weight);
+  }
+  if (tx) {
+    tx->Commit();
+  }
+}
+
+/************** TRANSACTIONS ******************/
+// Opens a transaction on graph. Only one transaction may record changes to a graph at a time,
+// and the graph must not be moved or assigned to while the transaction is open.
+template <typename N, typename E>
+gdwg::Graph<N, E>::Transaction::Transaction(gdwg::Graph<N, E>& graph) : graph_{&graph} {
+  if (graph.transaction_ != nullptr) {
+    throw std::runtime_error("Cannot open a Graph::Transaction on a graph "
+                             "that already has an open transaction");
+  }
+  graph.transaction_ = this;
+}
+
+// A transaction that was neither committed nor rolled back is rolled back on destruction,
+// so an exception thrown part way through a batch leaves the graph as it was.
+template <typename N, typename E>
+gdwg::Graph<N, E>::Transaction::~Transaction() {
+  Rollback();
+}
+
+// Keeps every change made since the transaction was opened and performs the
+// single re-sort of the edges that was deferred while it was open.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Transaction::Commit() {
+  if (graph_ == nullptr) {
+    throw std::runtime_error("Cannot call Graph::Transaction::Commit on a closed transaction");
+  }
+  graph_->transaction_ = nullptr;
+  if (resort_) {
+    graph_->SortEdges();
+  }
+  for (auto& delta : deltas_) {
+    graph_->Publish(std::move(delta));
+  }
+  graph_ = nullptr;
+  log_.clear();
+  deltas_.clear();
+}
+
+// Reverts every change made since the transaction was opened by replaying the undo log
+// backwards. Nothing is re-sorted during the transaction, so every recorded position is
+// still valid when its record is undone. Does nothing if the transaction is already closed.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Transaction::Rollback() noexcept {
+  if (graph_ == nullptr) {
+    return;
+  }
+  for (auto it = log_.rbegin(); it != log_.rend(); ++it) {
+    graph_->Undo(*it);
+  }
+  graph_->transaction_ = nullptr;
+  graph_ = nullptr;
+  log_.clear();
+  deltas_.clear();
+}
+
+// Removes the edge at it from edges_, and from in_edges_, updating the degrees of both of its
+// nodes, and returns an iterator to the edge that followed it in edges_.
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::EdgeList::iterator
+gdwg::Graph<N, E>::EraseEdge(typename EdgeList::iterator it) {
+  AddDegrees(*(*it)->src_.lock(), 0, -1);
+  AddDegrees(*(*it)->dest_.lock(), -1, 0);
+  UndoRecord record = {};
+  record.kind_ = UndoRecord::Kind::kEraseEdge;
+  record.position_ = it - edges_.begin();
+  // Outside of a transaction in_edges_ is sorted, so only the edge's equals need scanning
+  auto in_it = transaction_ == nullptr
+                   ? std::lower_bound(in_edges_.begin(), in_edges_.end(), *it, CompareSortByDest)
+                   : in_edges_.begin();
+  in_it = std::find(in_it, in_edges_.end(), *it);
+  record.in_position_ = in_it - in_edges_.begin();
+  in_edges_.erase(in_it);
+  record.edge_ = std::move(*it);
+  it = edges_.erase(it);
+  Record(std::move(record));
+  return it;
+}
+
+// Points edge at a new src and dest, moving the degree counts from the old nodes to the new ones.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RetargetEdge(const std::shared_ptr<Edge>& edge,
+                                     const std::shared_ptr<Node>& src,
+                                     const std::shared_ptr<Node>& dest) {
+  UndoRecord record = {};
+  record.kind_ = UndoRecord::Kind::kRetarget;
+  record.edge_ = edge;
+  record.src_ = edge->src_;
+  record.dest_ = edge->dest_;
+  AddDegrees(*edge->src_.lock(), 0, -1);
+  AddDegrees(*edge->dest_.lock(), -1, 0);
+  edge->src_ = src;
+  edge->dest_ = dest;
+  AddDegrees(*src, 0, 1);
+  AddDegrees(*dest, 1, 0);
+  Record(std::move(record));
+}
+
+// Allocates a copy of node from the graph's memory resource.
+template <typename N, typename E>
+std::shared_ptr<typename gdwg::Graph<N, E>::Node> gdwg::Graph<N, E>::MakeNode(const Node& node) {
+  return std::allocate_shared<Node>(std::pmr::polymorphic_allocator<Node>{GetMemoryResource()},
+                                    node);
+}
+
+// Allocates a copy of edge from the graph's memory resource.
+template <typename N, typename E>
+std::shared_ptr<typename gdwg::Graph<N, E>::Edge> gdwg::Graph<N, E>::MakeEdge(const Edge& edge) {
+  return std::allocate_shared<Edge>(std::pmr::polymorphic_allocator<Edge>{GetMemoryResource()},
+                                    edge);
+}
+
+// Replaces the contents of this graph with copies of other's nodes and edges, allocated from
+// this graph's memory resource. The copied edges point at the copied nodes, found through the
+// index_ they share with the originals, and keep their order.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::CopyFrom(const gdwg::Graph<N, E>& other) {
+  nodes_.clear();
+  edges_.clear();
+  in_edges_.clear();
+  degrees_.in_.clear();
+  degrees_.out_.clear();
+  nodes_.reserve(other.nodes_.size());
+  edges_.reserve(other.edges_.size());
+  for (const auto& node : other.nodes_) {
+    AppendNode(*node);
+  }
+  for (const auto& edge : other.edges_) {
+    Edge new_edge = {};
+    new_edge.weight_ = edge->weight_;
+    new_edge.src_ = nodes_[edge->src_.lock()->index_];
+    new_edge.dest_ = nodes_[edge->dest_.lock()->index_];
+    edges_.push_back(MakeEdge(new_edge));
+  }
+  RebuildInEdges();
+}
+
+// Allocates a copy of node at the end of nodes_ and gives it the matching index_.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::AppendNode(const Node& node) {
+  nodes_.push_back(MakeNode(node));
+  nodes_.back()->index_ = nodes_.size() - 1;
+  CountDegrees(*nodes_.back(), 1);
+}
+
+// Brings index_ back in line with the position of every node from position first onwards,
+// after a node has been inserted into or erased from the middle of nodes_.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Reindex(std::size_t first) {
+  for (auto i = first; i < nodes_.size(); ++i) {
+    nodes_[i]->index_ = i;
+  }
+}
+
+// Returns the node holding value, or nullptr if there is none.
+template <typename N, typename E>
+const typename gdwg::Graph<N, E>::Node* gdwg::Graph<N, E>::FindNode(const N& value) const
+    noexcept {
+  for (const auto& node : nodes_) {
+    if (node->value_ == value) {
+      return node.get();
+    }
+  }
+  return nullptr;
+}
+
+// Returns the range of edges_ leaving src. As edges_ is sorted by source first, the range is
+// contiguous and is found with two binary searches.
+template <typename N, typename E>
+std::pair<typename gdwg::Graph<N, E>::EdgeList::const_iterator,
+          typename gdwg::Graph<N, E>::EdgeList::const_iterator>
+gdwg::Graph<N, E>::OutEdges(const N& src) const {
+  auto first = std::lower_bound(edges_.cbegin(), edges_.cend(), src,
+                                [](const std::shared_ptr<Edge>& edge, const N& value) {
+                                  return edge->src_.lock()->value_ < value;
+                                });
+  auto last = std::upper_bound(first, edges_.cend(), src,
+                               [](const N& value, const std::shared_ptr<Edge>& edge) {
+                                 return value < edge->src_.lock()->value_;
+                               });
+  return {first, last};
+}
+
+// Returns the range of in_edges_ entering dest, found with two binary searches.
+template <typename N, typename E>
+std::pair<typename gdwg::Graph<N, E>::EdgeList::const_iterator,
+          typename gdwg::Graph<N, E>::EdgeList::const_iterator>
+gdwg::Graph<N, E>::InEdges(const N& dest) const {
+  auto first = std::lower_bound(in_edges_.cbegin(), in_edges_.cend(), dest,
+                                [](const std::shared_ptr<Edge>& edge, const N& value) {
+                                  return edge->dest_.lock()->value_ < value;
+                                });
+  auto last = std::upper_bound(first, in_edges_.cend(), dest,
+                               [](const N& value, const std::shared_ptr<Edge>& edge) {
+                                 return value < edge->dest_.lock()->value_;
+                               });
+  return {first, last};
+}
+
+// Rebuilds in_edges_ from edges_, for when every edge has been added at once.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RebuildInEdges() {
+  in_edges_.assign(edges_.begin(), edges_.end());
+  std::sort(in_edges_.begin(), in_edges_.end(), CompareSortByDest);
+}
+
+// Adds count, 1 or -1, to the degree index entries for node's current degrees. The index
+// only grows past a size it has held before when a degree reaches a new high, so restoring
+// an earlier state, as Undo does, never allocates.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::CountDegrees(const Node& node, int count) {
+  auto update = [count](std::pmr::vector<std::size_t>& histogram, int degree) {
+    auto d = static_cast<std::size_t>(degree);
+    if (d >= histogram.size()) {
+      histogram.resize(d + 1, 0);
+    }
+    if (count > 0) {
+      ++histogram[d];
+      return;
+    }
+    --histogram[d];
+    while (!histogram.empty() && histogram.back() == 0) {
+      histogram.pop_back();
+    }
+  };
+  update(degrees_.in_, node.indegree_);
+  update(degrees_.out_, node.outdegree_);
+}
+
+// Changes node's degrees by in and out, keeping the degree index in step.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::AddDegrees(Node& node, int in, int out) {
+  CountDegrees(node, -1);
+  node.indegree_ += in;
+  node.outdegree_ += out;
+  CountDegrees(node, 1);
+}
+
+// Recounts the degree index from every node, for when the degrees were set in bulk.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RebuildDegreeIndex() {
+  degrees_.in_.clear();
+  degrees_.out_.clear();
+  for (const auto& node : nodes_) {
+    CountDegrees(*node, 1);
+  }
+}
+
+// Restores CompareSort order on edges_, and CompareSortByDest order on in_edges_,
+// or leaves it to Commit() if a transaction is open.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::SortEdges() {
+  if (transaction_ != nullptr) {
+    transaction_->resort_ = true;
+    return;
+  }
+  std::sort(this->edges_.begin(), this->edges_.end(), CompareSort);
+  std::sort(this->in_edges_.begin(), this->in_edges_.end(), CompareSortByDest);
+}
+
+// Appends record to the open transaction's undo log. Does nothing outside of a transaction.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Record(UndoRecord&& record) {
+  if (transaction_ != nullptr) {
+    transaction_->log_.push_back(std::move(record));
+  }
+}
+
+// Reverses the change described by record. Records must be undone in the reverse of the
+// order they were made in, which guarantees every recorded position is valid again.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Undo(UndoRecord& record) noexcept {
+  switch (record.kind_) {
+    case UndoRecord::Kind::kInsertNode:
+      CountDegrees(*nodes_[record.position_], -1);
+      nodes_.erase(nodes_.begin() + record.position_);
+      Reindex(record.position_);
+      break;
+    case UndoRecord::Kind::kDeleteNode:
+      CountDegrees(*record.node_, 1);
+      nodes_.insert(nodes_.begin() + record.position_, std::move(record.node_));
+      Reindex(record.position_);
+      break;
+    case UndoRecord::Kind::kInsertEdge: {
+      auto it = edges_.begin() + record.position_;
+      AddDegrees(*(*it)->src_.lock(), 0, -1);
+      AddDegrees(*(*it)->dest_.lock(), -1, 0);
+      edges_.erase(it);
+      in_edges_.erase(in_edges_.begin() + record.in_position_);
+      break;
+    }
+    case UndoRecord::Kind::kEraseEdge:
+      AddDegrees(*record.edge_->src_.lock(), 0, 1);
+      AddDegrees(*record.edge_->dest_.lock(), 1, 0);
+      in_edges_.insert(in_edges_.begin() + record.in_position_, record.edge_);
+      edges_.insert(edges_.begin() + record.position_, std::move(record.edge_));
+      break;
+    case UndoRecord::Kind::kReplace:
+      record.node_->value_ = std::move(*record.value_);
+      break;
+    case UndoRecord::Kind::kRetarget:
+      AddDegrees(*record.edge_->src_.lock(), 0, -1);
+      AddDegrees(*record.edge_->dest_.lock(), -1, 0);
+      record.edge_->src_ = record.src_;
+      record.edge_->dest_ = record.dest_;
+      AddDegrees(*record.edge_->src_.lock(), 0, 1);
+      AddDegrees(*record.edge_->dest_.lock(), 1, 0);
+      break;
+    case UndoRecord::Kind::kClear:
+      nodes_ = std::move(record.nodes_);
+      edges_ = std::move(record.edges_);
+      in_edges_ = std::move(record.in_edges_);
+      RebuildDegreeIndex();
+      break;
+  }
+}
+
+/************** DEGREES ******************/
+template <typename N, typename E>
+int gdwg::Graph<N, E>::GetInDegree(const N& node) const {
+  const Node* found = FindNode(node);
+  if (found == nullptr) {
+    throw std::out_of_range("Cannot call Graph::GetInDegree if the node doesn't exist in the "
+                            "graph");
+  }
+  return found->indegree_;
+}
+
+template <typename N, typename E>
+int gdwg::Graph<N, E>::GetOutDegree(const N& node) const {
+  const Node* found = FindNode(node);
+  if (found == nullptr) {
+    throw std::out_of_range("Cannot call Graph::GetOutDegree if the node doesn't exist in the "
+                            "graph");
+  }
+  return found->outdegree_;
+}
+
+template <typename N, typename E>
+std::vector<std::size_t> gdwg::Graph<N, E>::GetDegreeHistogram(Degree kind) const {
+  const auto& histogram = kind == Degree::kIn ? degrees_.in_ : degrees_.out_;
+  return std::vector<std::size_t>(histogram.begin(), histogram.end());
+}
+
+// The histogram gives the lowest degree that makes the top k, so only the nodes at or above
+// it are collected and sorted.
+template <typename N, typename E>
+std::vector<N> gdwg::Graph<N, E>::TopByDegree(std::size_t k, Degree kind) const {
+  const auto& histogram = kind == Degree::kIn ? degrees_.in_ : degrees_.out_;
+  auto degree = [kind](const Node& node) {
+    return kind == Degree::kIn ? node.indegree_ : node.outdegree_;
+  };
+  std::size_t threshold = histogram.size();
+  for (std::size_t above = 0; threshold > 0 && above < k;) {
+    above += histogram[--threshold];
+  }
+  std::vector<const Node*> top;
+  for (const auto& node : nodes_) {
+    if (static_cast<std::size_t>(degree(*node)) >= threshold) {
+      top.push_back(node.get());
+    }
+  }
+  auto by_degree = [&degree](const Node* a, const Node* b) {
+    return degree(*a) != degree(*b) ? degree(*a) > degree(*b) : a->value_ < b->value_;
+  };
+  k = std::min(k, top.size());
+  std::partial_sort(top.begin(), top.begin() + k, top.end(), by_degree);
+  std::vector<N> result;
+  for (std::size_t i = 0; i < k; ++i) {
+    result.push_back(top[i]->value_);
+  }
+  return result;
+}
+
+/************** TRAVERSALS ******************/
+// Returns a lazy breadth first traversal of the nodes reachable from start, start included.
+// Throws a std::out_of_range exception if start is not a node in the graph, and a
+// std::runtime_error if a transaction is open, as edges_ is not sorted until it commits.
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::Traversal gdwg::Graph<N, E>::BreadthFirst(const N& start) const {
+  const Node* node = FindNode(start);
+  if (node == nullptr) {
+    throw std::out_of_range("Cannot call Graph::BreadthFirst "
+                            "if start doesn't exist in the graph");
+  }
+  if (transaction_ != nullptr) {
+    throw std::runtime_error("Cannot call Graph::BreadthFirst while a transaction is open");
+  }
+  return Traversal{*this, node, false};
+}
+
+// As the above function, but the nodes are visited depth first (pre-order).
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::Traversal gdwg::Graph<N, E>::DepthFirst(const N& start) const {
+  const Node* node = FindNode(start);
+  if (node == nullptr) {
+    throw std::out_of_range("Cannot call Graph::DepthFirst "
+                            "if start doesn't exist in the graph");
+  }
+  if (transaction_ != nullptr) {
+    throw std::runtime_error("Cannot call Graph::DepthFirst while a transaction is open");
+  }
+  return Traversal{*this, node, true};
+}
+
+// The visited bitmap is indexed by each node's index_, and is the only allocation
+// proportional to the size of the graph.
+template <typename N, typename E>
+gdwg::Graph<N, E>::Traversal::Traversal(const gdwg::Graph<N, E>& graph,
+                                        const Node* start,
+                                        bool depth_first)
+  : graph_{&graph}, depth_first_{depth_first}, current_{start},
+    visited_(graph.nodes_.size(), false) {
+  visited_[start->index_] = true;
+}
+
+// Moves the traversal on to the next node, expanding the outgoing edges of the current one.
+// Breadth first marks a node visited when it is queued so each node is queued at most once.
+// Depth first marks a node visited when it is popped, which is what gives a pre-order walk.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Traversal::Advance() {
+  auto [first, last] = graph_->OutEdges(current_->value_);
+  current_ = nullptr;
+  if (depth_first_) {
+    // Pushed in reverse so that the smallest neighbour is popped first
+    for (auto it = last; it != first;) {
+      --it;
+      const Node* dest = (*it)->dest_.lock().get();
+      if (!visited_[dest->index_]) {
+        frontier_.push_back(dest);
+      }
+    }
+    while (!frontier_.empty() && current_ == nullptr) {
+      const Node* next = frontier_.back();
+      frontier_.pop_back();
+      if (!visited_[next->index_]) {
+        visited_[next->index_] = true;
+        current_ = next;
+      }
+    }
+    return;
+  }
+  for (auto it = first; it != last; ++it) {
+    const Node* dest = (*it)->dest_.lock().get();
+    if (!visited_[dest->index_]) {
+      visited_[dest->index_] = true;
+      frontier_.push_back(dest);
+    }
+  }
+  if (!frontier_.empty()) {
+    current_ = frontier_.front();
+    frontier_.pop_front();
+  }
+}
+
+// CompareSortByDest -- NOT IN SPECIFICATION --
+// As CompareSort, but orders edges by destination node first, then source node, then weight.
+// Used to keep in_edges_ sorted.
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::CompareSortByDest(const std::shared_ptr<Edge>& a,
+                                          const std::shared_ptr<Edge>& b) {
+  const auto& a_dest = a->dest_.lock()->value_;
+  const auto& b_dest = b->dest_.lock()->value_;
+  if (a_dest < b_dest) {
+    return true;
+  }
+  if (b_dest < a_dest) {
+    return false;
+  }
+  const auto& a_src = a->src_.lock()->value_;
+  const auto& b_src = b->src_.lock()->value_;
+  if (a_src < b_src) {
+    return true;
+  }
+  if (b_src < a_src) {
+    return false;
+  }
+  return a->weight_ < b->weight_;
+}
+
+/************** EDGE RANGES ******************/
+// Returns the edges leaving src, in iteration order, positioned with a binary search in
+// O(log E). A value that is not a node in the graph has no edges, so gives an empty range.
+// Throws a std::runtime_error if a transaction is open, as the edges are not sorted until it
+// commits.
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::EdgeRange gdwg::Graph<N, E>::EdgesFrom(const N& src) const {
+  if (transaction_ != nullptr) {
+    throw std::runtime_error("Cannot call Graph::EdgesFrom while a transaction is open");
+  }
+  auto [first, last] = OutEdges(src);
+  EdgeRange range;
+  range.first_.iterator_ = first;
+  range.first_.end_iterator_ = edges_.cend();
+  range.last_.iterator_ = last;
+  range.last_.end_iterator_ = edges_.cend();
+  return range;
+}
+
+// Returns the edges entering dest, ordered by source then weight, positioned with a binary
+// search in O(log E) over in_edges_. As the edges do not come from the main iteration order,
+// these iterators must not be passed to erase(const_iterator).
+// Throws a std::runtime_error if a transaction is open, as the edges are not sorted until it
+// commits.
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::EdgeRange gdwg::Graph<N, E>::EdgesTo(const N& dest) const {
+  if (transaction_ != nullptr) {
+    throw std::runtime_error("Cannot call Graph::EdgesTo while a transaction is open");
+  }
+  auto [first, last] = InEdges(dest);
+  EdgeRange range;
+  range.first_.iterator_ = first;
+  range.first_.end_iterator_ = in_edges_.cend();
+  range.last_.iterator_ = last;
+  range.last_.end_iterator_ = in_edges_.cend();
+  return range;
+}
+
+/************** SHORTEST PATHS ******************/
+// Returns the cost of the cheapest path from src to dst, or std::nullopt if dst can't be
+// reached from src. The path itself can then be read with Path().
+// Nodes are expanded in order of score plus heuristic, using a binary heap with lazy
+// deletion. A closed node is reopened if a cheaper path to it is found, so the heuristic only
+// needs to be admissible, not consistent.
+// Throws a std::out_of_range exception if src or dst is not a node, and a std::runtime_error
+// if the graph has an open transaction.
+template <typename N, typename E>
+template <typename Heuristic>
+std::optional<E> gdwg::Graph<N, E>::AStar::Search(const N& src, const N& dst, Heuristic heuristic) {
+  if (graph_->transaction_ != nullptr) {
+    throw std::runtime_error("Cannot call Graph::AStar::Search while a transaction is open");
+  }
+  const Node* start = graph_->FindNode(src);
+  const Node* goal = graph_->FindNode(dst);
+  if (start == nullptr || goal == nullptr) {
+    throw std::out_of_range("Cannot call Graph::AStar::Search if src "
+                            "or dst node don't exist in the graph");
+  }
+  Prepare();
+  start_ = start->index_;
+  goal_ = goal->index_;
+  found_ = false;
+
+  auto later = [](const std::pair<E, std::size_t>& a, const std::pair<E, std::size_t>& b) {
+    return b.first < a.first;
+  };
+  seen_[start_] = epoch_;
+  g_score_[start_] = E{};
+  came_from_[start_] = start_;
+  heap_.emplace_back(heuristic(start->value_), start_);
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), later);
+    auto current = heap_.back().second;
+    heap_.pop_back();
+    // A stale heap entry for a node that has since been expanded
+    if (closed_[current] == epoch_) {
+      continue;
+    }
+    closed_[current] = epoch_;
+    if (current == goal_) {
+      found_ = true;
+      return g_score_[current];
+    }
+    auto [first, last] = graph_->OutEdges(graph_->nodes_[current]->value_);
+    for (auto it = first; it != last; ++it) {
+      auto dest = (*it)->dest_.lock();
+      auto next = dest->index_;
+      E score = g_score_[current] + (*it)->weight_;
+      if (seen_[next] == epoch_ && !(score < g_score_[next])) {
+        continue;
+      }
+      seen_[next] = epoch_;
+      g_score_[next] = score;
+      came_from_[next] = current;
+      closed_[next] = 0;
+      heap_.emplace_back(score + heuristic(dest->value_), next);
+      std::push_heap(heap_.begin(), heap_.end(), later);
+    }
+  }
+  return std::nullopt;
+}
+
+// Returns the nodes of the path found by the last successful Search, from src to dst.
+// Returns an empty vector if the last Search found no path.
+template <typename N, typename E>
+std::vector<N> gdwg::Graph<N, E>::AStar::Path() const {
+  std::vector<N> path;
+  if (!found_) {
+    return path;
+  }
+  for (auto node = goal_; node != start_; node = came_from_[node]) {
+    path.push_back(graph_->nodes_[node]->value_);
+  }
+  path.push_back(graph_->nodes_[start_]->value_);
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+// Readies the buffers for a new query: grows them if the graph has grown, and starts a new
+// epoch so that every score and closed mark from earlier queries is ignored.
+template <typename N, typename E>
+void gdwg::Graph<N, E>::AStar::Prepare() {
+  auto size = graph_->nodes_.size();
+  if (g_score_.size() < size) {
+    g_score_.resize(size);
+    came_from_.resize(size);
+    seen_.resize(size, 0);
+    closed_.resize(size, 0);
+  }
+  heap_.clear();
+  // Epoch 0 is never used, so that 0 always means unmarked
+  if (++epoch_ == 0) {
+    std::fill(seen_.begin(), seen_.end(), 0);
+    std::fill(closed_.begin(), closed_.end(), 0);
+    epoch_ = 1;
+  }
+}
+
+/************** ITERATORS ******************/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::operator++() {
+  ++iterator_;
+  return *this;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::operator--() {
+  --iterator_;
+  return *this;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cbegin() const noexcept {
+  const_iterator it;
+  it.iterator_ = edges_.cbegin();
+  it.end_iterator_ = edges_.cend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cend() const noexcept {
+  const_iterator it;
+  it.iterator_ = edges_.cend();
+  it.end_iterator_ = edges_.cend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cbegin() noexcept {
+  const_iterator it;
+  it.iterator_ = edges_.cbegin();
+  it.end_iterator_ = edges_.cend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cend() noexcept {
+  const_iterator it;
+  it.iterator_ = edges_.cend();
+  it.end_iterator_ = edges_.cend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator
+gdwg::Graph<N, E>::find(const N& src, const N& dest, const E& weight) {
+  const_iterator it;
+  it.iterator_ = edges_.cbegin();
+  it.end_iterator_ = edges_.cend();
+
+  while (it.iterator_ != it.end_iterator_) {
+    auto node = *(it.iterator_);
+    if (node->src_.lock()->value_ == src && node->dest_.lock()->value_ == dest &&
+        node->weight_ == weight) {
+      break;
+    }
+    ++it.iterator_;
+  }
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator
+gdwg::Graph<N, E>::find(const N& src, const N& dest, const E& weight) const {
+  const_iterator it;
+  it.iterator_ = edges_.cbegin();
+  it.end_iterator_ = edges_.cend();
+
+  while (it.iterator_ != it.end_iterator_) {
+    auto node = *(it.iterator_);
+    if (node->src_.lock()->value_ == src && node->dest_.lock()->value_ == dest &&
+        node->weight_ == weight) {
+      break;
+    }
+    ++it.iterator_;
+  }
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::erase(const_iterator old_it) {
+  if (old_it.iterator_ == old_it.end_iterator_ || *old_it.iterator_ == nullptr) {
+    return old_it;
+  }
+  N& erase_src = old_it.iterator_->get()->src_.lock()->value_;
+  N& erase_dest = old_it.iterator_->get()->dest_.lock()->value_;
+  E& erase_weight = old_it.iterator_->get()->weight_;
+
+  // If the iterator is pointing to the last element already, delete it and return end()
+  if ((old_it.iterator_ != old_it.end_iterator_) &&
+      (next(old_it.iterator_) == old_it.end_iterator_)) {
+    this->erase(erase_src, erase_dest, erase_weight);
+    return this->end();
+  }
+
+  ++old_it.iterator_;
+  N& new_src = old_it.iterator_->get()->src_.lock()->value_;
+  N& new_dest = old_it.iterator_->get()->dest_.lock()->value_;
+  E& new_weight = old_it.iterator_->get()->weight_;
+  bool deleted = this->erase(erase_src, erase_dest, erase_weight);
+
+  // If no erase can be made, the equivalent of gdwg::Graph<N, E>::end() is returned.
+  if (deleted == false) {
+    return this->end();
+  }
+  return this->find(new_src, new_dest, new_weight);
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_reverse_iterator& gdwg::Graph<N, E>::const_reverse_iterator::
+operator++() {
+  ++iterator_;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_reverse_iterator& gdwg::Graph<N, E>::const_reverse_iterator::
+operator--() {
+  --iterator_;
+  return *this;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crbegin() noexcept {
+  const_reverse_iterator it;
+  it.iterator_ = edges_.crbegin();
+  it.end_iterator_ = edges_.crend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crend() noexcept {
+  const_reverse_iterator it;
+  it.iterator_ = edges_.crend();
+  it.end_iterator_ = edges_.crend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crbegin() const noexcept {
+  const_reverse_iterator it;
+  it.iterator_ = edges_.crbegin();
+  it.end_iterator_ = edges_.crend();
+  return it;
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_reverse_iterator gdwg::Graph<N, E>::crend() const noexcept {
+  const_reverse_iterator it;
+  it.iterator_ = edges_.crend();
+  it.end_iterator_ = edges_.crend();
+  return it;
+}
+
+/************** CONCURRENT GRAPH ******************/
+template <typename N, typename E>
+gdwg::ConcurrentGraph<N, E>::ConcurrentGraph(Graph<N, E> initial, std::size_t reader_slots)
+  : slots_{std::make_unique<Slot[]>(std::max<std::size_t>(1, reader_slots))},
+    slot_count_{std::max<std::size_t>(1, reader_slots)},
+    latest_{std::make_unique<Published>(
+        Published{std::make_unique<Graph<N, E>>(std::move(initial)), 0})} {
+  current_.store(latest_.get());
+}
+
+// Every Snapshot must have been released, so every version can go.
+template <typename N, typename E>
+gdwg::ConcurrentGraph<N, E>::~ConcurrentGraph() = default;
+
+// Claims a free slot by announcing the current epoch in it, then loads the latest version. A
+// writer that retires that version afterwards, in the same epoch or a later one, sees the
+// announcement and keeps the version until the slot is released. Readers start looking at a
+// slot chosen by thread, so that they rarely contend for the same one.
+template <typename N, typename E>
+typename gdwg::ConcurrentGraph<N, E>::Snapshot gdwg::ConcurrentGraph<N, E>::Read() const {
+  auto first = std::hash<std::thread::id>{}(std::this_thread::get_id()) % slot_count_;
+  for (;;) {
+    for (std::size_t i = 0; i < slot_count_; ++i) {
+      auto& slot = slots_[(first + i) % slot_count_].epoch_;
+      auto idle = kIdle;
+      if (slot.load(std::memory_order_relaxed) == kIdle &&
+          slot.compare_exchange_strong(idle, epoch_.load())) {
+        const Published* published = current_.load();
+        return Snapshot{&slot, published->graph_.get(), published->version_};
+      }
+    }
+    std::this_thread::yield();
+  }
+}
+
+template <typename N, typename E>
+std::uint64_t
+gdwg::ConcurrentGraph<N, E>::Update(const std::function<void(Graph<N, E>&)>& update) {
+  std::lock_guard<std::mutex> lock{writer_};
+  auto copy = std::make_unique<Graph<N, E>>(*latest_->graph_);
+  update(*copy);
+  return PublishLocked(std::move(copy));
+}
+
+template <typename N, typename E>
+std::uint64_t gdwg::ConcurrentGraph<N, E>::Publish(Graph<N, E> graph) {
+  std::lock_guard<std::mutex> lock{writer_};
+  return PublishLocked(std::make_unique<Graph<N, E>>(std::move(graph)));
+}
+
+template <typename N, typename E>
+void gdwg::ConcurrentGraph<N, E>::Reclaim() {
+  std::lock_guard<std::mutex> lock{writer_};
+  ReclaimLocked();
+}
+
+template <typename N, typename E>
+std::size_t gdwg::ConcurrentGraph<N, E>::Retired() const {
+  std::lock_guard<std::mutex> lock{writer_};
+  return retired_.size();
+}
+
+// Swaps in the new version, then retires the old one in the epoch that was current when it
+// stopped being reachable, and moves on to the next epoch.
+template <typename N, typename E>
+std::uint64_t gdwg::ConcurrentGraph<N, E>::PublishLocked(std::unique_ptr<Graph<N, E>> graph) {
+  auto published = std::make_unique<Published>(Published{std::move(graph), next_version_++});
+  current_.store(published.get());
+  retired_.push_back(Retiree{std::move(latest_), epoch_.fetch_add(1)});
+  latest_ = std::move(published);
+  ReclaimLocked();
+  return latest_->version_;
+}
+
+// A version retired in epoch t can only be held by Snapshots that announced epoch t or earlier.
+template <typename N, typename E>
+void gdwg::ConcurrentGraph<N, E>::ReclaimLocked() {
+  auto oldest = kIdle;
+  for (std::size_t i = 0; i < slot_count_; ++i) {
+    oldest = std::min(oldest, slots_[i].epoch_.load());
+  }
+  retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                [oldest](const Retiree& retiree) {
+                                  return retiree.epoch_ < oldest;
+                                }),
+                 retired_.end());
+}
+
+template <typename N, typename E>
+gdwg::ConcurrentGraph<N, E>::Snapshot::Snapshot(std::atomic<std::uint64_t>* slot,
+                                                const Graph<N, E>* graph,
+                                                std::uint64_t version) noexcept
+  : slot_{slot}, graph_{graph}, version_{version} {}
+
+template <typename N, typename E>
+gdwg::ConcurrentGraph<N, E>::Snapshot::Snapshot(Snapshot&& other) noexcept
+  : slot_{other.slot_}, graph_{other.graph_}, version_{other.version_} {
+  other.slot_ = nullptr;
+}
+
+template <typename N, typename E>
+typename gdwg::ConcurrentGraph<N, E>::Snapshot& gdwg::ConcurrentGraph<N, E>::Snapshot::
+operator=(Snapshot&& other) noexcept {
+  if (&other != this) {
+    Release();
+    slot_ = other.slot_;
+    graph_ = other.graph_;
+    version_ = other.version_;
+    other.slot_ = nullptr;
+  }
+  return *this;
+}
+
+template <typename N, typename E>
+gdwg::ConcurrentGraph<N, E>::Snapshot::~Snapshot() {
+  Release();
+}
+
+// Frees the slot, after which this Snapshot's version may be deleted at any time.
+template <typename N, typename E>
+void gdwg::ConcurrentGraph<N, E>::Snapshot::Release() noexcept {
+  if (slot_ != nullptr) {
+    slot_->store(kIdle);
+    slot_ = nullptr;
+  }
 }
 
 #endif  // ASSIGNMENTS_DG_GRAPH_T_
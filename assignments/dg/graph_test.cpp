@@ -17,7 +17,15 @@
 
 */
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory_resource>
+#include <set>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "assignments/dg/graph.h"
@@ -1170,3 +1178,1027 @@ SCENARIO("A graph can be printed out for the user") {
     }
   }
 }
+
+// Transactions
+SCENARIO("Mutations can be batched in a transaction") {
+  GIVEN("A graph 'g' with nodes {a, b, c} and edges a->b, b->c") {
+    const std::tuple<std::string, std::string, int> tup1{"a", "b", 1};
+    const std::tuple<std::string, std::string, int> tup2{"b", "c", 2};
+    const auto e = std::vector<std::tuple<std::string, std::string, int>>{tup1, tup2};
+    gdwg::Graph<std::string, int> g{e.begin(), e.end()};
+    std::ostringstream before;
+    before << g;
+    WHEN("A batch of changes is made inside a transaction that is committed") {
+      {
+        gdwg::Graph<std::string, int>::Transaction tx{g};
+        g.InsertNode("d");
+        g.InsertEdge("d", "a", 4);
+        g.InsertEdge("a", "a", 3);
+        g.erase("b", "c", 2);
+        g.Replace("c", "e");
+        tx.Commit();
+        REQUIRE_FALSE(tx.IsActive());
+      }
+      THEN("The changes are kept and the edges are in sorted order") {
+        std::vector<std::string> expected{"a", "b", "d", "e"};
+        REQUIRE(g.GetNodes() == expected);
+        std::ostringstream stream;
+        stream << g;
+        REQUIRE(stream.str() == "a (\n  a | 3\n  b | 1\n)\nb (\n)\nd (\n  a | 4\n)\ne (\n)\n");
+        std::vector<std::string> into_a;
+        for (const auto& edge : g.EdgesTo("a")) {
+          into_a.push_back(std::get<0>(edge));
+        }
+        REQUIRE(into_a == std::vector<std::string>{"a", "d"});
+      }
+    }
+    WHEN("A batch of changes is made inside a transaction that is rolled back") {
+      gdwg::Graph<std::string, int>::Transaction tx{g};
+      g.InsertNode("d");
+      g.InsertEdge("d", "a", 4);
+      g.MergeReplace("b", "a");
+      g.DeleteNode("c");
+      g.Replace("a", "z");
+      tx.Rollback();
+      THEN("The graph is exactly as it was before the transaction") {
+        std::ostringstream after;
+        after << g;
+        REQUIRE(after.str() == before.str());
+        REQUIRE(g.GetConnected("a") == std::vector<std::string>{"b"});
+        REQUIRE(std::get<0>(*g.EdgesTo("c").begin()) == "b");
+        REQUIRE_FALSE(tx.IsActive());
+      }
+    }
+    WHEN("An InsertEdge throws part way through a transaction") {
+      try {
+        gdwg::Graph<std::string, int>::Transaction tx{g};
+        g.InsertNode("d");
+        g.InsertEdge("a", "d", 9);
+        g.InsertEdge("a", "x", 1);
+        tx.Commit();
+      } catch (const std::runtime_error&) {
+      }
+      THEN("The transaction is rolled back as it goes out of scope") {
+        std::ostringstream after;
+        after << g;
+        REQUIRE(after.str() == before.str());
+        REQUIRE_FALSE(g.InTransaction());
+      }
+    }
+    WHEN("The graph is cleared inside a transaction that is rolled back") {
+      {
+        gdwg::Graph<std::string, int>::Transaction tx{g};
+        g.clear();
+        REQUIRE(g.GetNodes().empty());
+      }
+      THEN("The nodes and edges are restored") {
+        std::ostringstream after;
+        after << g;
+        REQUIRE(after.str() == before.str());
+      }
+    }
+    WHEN("A second transaction is opened on the same graph") {
+      using Transaction = gdwg::Graph<std::string, int>::Transaction;
+      Transaction tx{g};
+      THEN("A std::runtime_error is thrown") {
+        REQUIRE_THROWS_AS(Transaction{g}, std::runtime_error);
+      }
+    }
+  }
+}
+
+// Memory resources
+// A memory_resource that counts the allocations made through it
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  int allocations_ = 0;
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations_;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+SCENARIO("Graphs can allocate from a user supplied memory resource") {
+  GIVEN("A graph 'g' constructed on a counting memory resource") {
+    CountingResource resource;
+    gdwg::Graph<int, int> g{{1, 2, 3}, &resource};
+    REQUIRE(g.GetMemoryResource() == &resource);
+    WHEN("Nodes and edges are inserted") {
+      int before = resource.allocations_;
+      g.InsertNode(4);
+      g.InsertEdge(1, 4, 7);
+      THEN("The new nodes and edges are allocated from the resource") {
+        REQUIRE(resource.allocations_ > before);
+      }
+    }
+    WHEN("An edge raises both of its nodes to a new highest degree") {
+      int before = resource.allocations_;
+      g.InsertEdge(1, 2, 7);
+      THEN("The edge, both edge lists and both degree histograms allocate from the resource") {
+        REQUIRE(resource.allocations_ - before == 5);
+        REQUIRE(g.GetDegreeHistogram(gdwg::Graph<int, int>::Degree::kOut) ==
+                std::vector<std::size_t>{2, 1});
+      }
+    }
+    WHEN("g is copied onto a different resource and the copy is changed") {
+      CountingResource other;
+      gdwg::Graph<int, int> copy{g, &other};
+      copy.Replace(1, 10);
+      copy.InsertEdge(10, 2, 1);
+      THEN("The copy allocated from its own resource and g is unchanged") {
+        REQUIRE(copy.GetMemoryResource() == &other);
+        REQUIRE(other.allocations_ > 0);
+        REQUIRE(g.GetNodes() == std::vector<int>{1, 2, 3});
+        REQUIRE_FALSE(g.IsConnected(1, 2));
+      }
+    }
+    WHEN("g is cleared inside a transaction that is rolled back") {
+      auto* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+      int before = resource.allocations_;
+      {
+        gdwg::Graph<int, int>::Transaction tx{g};
+        g.clear();
+        REQUIRE(g.GetNodes().empty());
+      }
+      int allocations = resource.allocations_ - before;
+      std::pmr::set_default_resource(previous);
+      THEN("The lists move into the undo log and back without allocating") {
+        REQUIRE(allocations == 0);
+        REQUIRE(g.GetNodes() == std::vector<int>{1, 2, 3});
+      }
+    }
+    WHEN("A graph on the default resource is move assigned from g") {
+      gdwg::Graph<int, int> h;
+      h = std::move(g);
+      THEN("h keeps the default resource and holds g's nodes") {
+        REQUIRE(h.GetMemoryResource() == std::pmr::get_default_resource());
+        REQUIRE(h.GetNodes() == std::vector<int>{1, 2, 3});
+      }
+    }
+  }
+  GIVEN("A monotonic buffer resource with no upstream allocator") {
+    std::byte buffer[16384];
+    std::pmr::monotonic_buffer_resource resource{buffer, sizeof(buffer),
+                                                 std::pmr::null_memory_resource()};
+    WHEN("A graph is built and torn down entirely within the buffer") {
+      std::vector<std::tuple<int, int, int>> e{{1, 2, 3}, {2, 3, 4}, {3, 1, 5}};
+      {
+        gdwg::Graph<int, int> g{e.begin(), e.end(), &resource};
+        g.DeleteNode(2);
+        g.InsertEdge(1, 3, 9);
+        REQUIRE(g.GetConnected(1) == std::vector<int>{3});
+      }
+      THEN("The whole buffer is released in one shot") { REQUIRE_NOTHROW(resource.release()); }
+    }
+  }
+}
+
+// Traversals
+SCENARIO("A graph can be traversed lazily breadth first and depth first") {
+  GIVEN("A graph 'g' where a->{b, c}, b->d, c->{a, d}, d->e and f is unreachable") {
+    std::vector<std::tuple<char, char, int>> e{{'a', 'c', 1}, {'a', 'b', 1}, {'b', 'd', 1},
+                                               {'c', 'a', 1}, {'c', 'd', 2}, {'c', 'd', 1},
+                                               {'d', 'e', 1}};
+    gdwg::Graph<char, int> g{e.begin(), e.end()};
+    g.InsertNode('f');
+    WHEN("g is traversed breadth first from 'a'") {
+      std::vector<char> visited;
+      for (const auto& node : g.BreadthFirst('a')) {
+        visited.push_back(node);
+      }
+      THEN("Each reachable node is visited once, nearest first") {
+        REQUIRE(visited == std::vector<char>{'a', 'b', 'c', 'd', 'e'});
+      }
+    }
+    WHEN("g is traversed depth first from 'a'") {
+      std::vector<char> visited;
+      for (const auto& node : g.DepthFirst('a')) {
+        visited.push_back(node);
+      }
+      THEN("Each reachable node is visited once, deepest first") {
+        REQUIRE(visited == std::vector<char>{'a', 'b', 'd', 'e', 'c'});
+      }
+    }
+    WHEN("A node is deleted and g is traversed depth first from 'c'") {
+      g.DeleteNode('b');
+      std::vector<char> visited;
+      for (const auto& node : g.DepthFirst('c')) {
+        visited.push_back(node);
+      }
+      THEN("The traversal follows the remaining edges") {
+        REQUIRE(visited == std::vector<char>{'c', 'a', 'd', 'e'});
+      }
+    }
+    WHEN("The consumer stops part way through a breadth first traversal") {
+      auto traversal = g.BreadthFirst('a');
+      auto it = traversal.begin();
+      ++it;
+      THEN("The traversal can be resumed from where it stopped") {
+        REQUIRE(*it == 'b');
+        ++it;
+        REQUIRE(*it == 'c');
+        REQUIRE(it != traversal.end());
+      }
+    }
+    WHEN("A traversal is started from a node that doesn't exist") {
+      THEN("A std::out_of_range is thrown") {
+        REQUIRE_THROWS_WITH(g.BreadthFirst('z'), "Cannot call Graph::BreadthFirst "
+                                                 "if start doesn't exist in the graph");
+        REQUIRE_THROWS_AS(g.DepthFirst('z'), std::out_of_range);
+      }
+    }
+  }
+}
+
+// Minimum spanning forests
+SCENARIO("The minimum spanning forest of a graph can be found") {
+  GIVEN("A graph 'g' with two connected components, a self edge, a tie and an isolated node") {
+    std::vector<std::tuple<std::string, std::string, double>> e{
+        {"a", "b", 4}, {"a", "c", 2}, {"b", "c", 1}, {"c", "a", 2}, {"c", "c", 0}, {"d", "e", 5}};
+    gdwg::Graph<std::string, double> g{e.begin(), e.end()};
+    g.InsertNode("f");
+    WHEN("The forest is found with Kruskal's and Boruvka's algorithms") {
+      auto kruskal = g.KruskalSpanningForest();
+      auto boruvka = g.BoruvkaSpanningForest();
+      THEN("Both pick the same edges, by position in iteration order") {
+        REQUIRE(kruskal == std::vector<std::size_t>{1, 2, 5});
+        REQUIRE(boruvka == kruskal);
+      }
+    }
+    WHEN("The forest is extracted as a new graph") {
+      auto forest = g.MinimumSpanningForest();
+      THEN("It has every node of g and only the forest's edges") {
+        std::ostringstream stream;
+        stream << forest;
+        REQUIRE(stream.str() ==
+                "a (\n  c | 2\n)\nb (\n  c | 1\n)\nc (\n)\nd (\n  e | 5\n)\ne (\n)\nf (\n)\n");
+        REQUIRE(forest.GetMemoryResource() == g.GetMemoryResource());
+      }
+    }
+  }
+  GIVEN("A graph with no edges") {
+    gdwg::Graph<int, double> g{1, 2, 3};
+    THEN("The forest is empty") {
+      REQUIRE(g.KruskalSpanningForest().empty());
+      REQUIRE(g.BoruvkaSpanningForest().empty());
+      REQUIRE(g.MinimumSpanningForest().GetNodes() == std::vector<int>{1, 2, 3});
+    }
+  }
+}
+
+// Edge ranges
+SCENARIO("The edges leaving or entering a single node can be iterated") {
+  GIVEN("A graph 'g' with edges a->b, a->c (x2), b->c, c->a and an isolated node d") {
+    std::vector<std::tuple<char, char, int>> e{
+        {'c', 'a', 1}, {'a', 'c', 5}, {'b', 'c', 2}, {'a', 'b', 3}, {'a', 'c', 4}};
+    gdwg::Graph<char, int> g{e.begin(), e.end()};
+    g.InsertNode('d');
+    WHEN("The edges from 'a' are collected") {
+      std::vector<std::tuple<char, char, int>> edges;
+      for (const auto& [src, dest, weight] : g.EdgesFrom('a')) {
+        edges.emplace_back(src, dest, weight);
+      }
+      THEN("Only a's outgoing edges are visited, in iteration order") {
+        std::vector<std::tuple<char, char, int>> expected{
+            {'a', 'b', 3}, {'a', 'c', 4}, {'a', 'c', 5}};
+        REQUIRE(edges == expected);
+      }
+    }
+    WHEN("The edges to 'c' are collected after another edge into c is inserted") {
+      g.InsertEdge('c', 'c', 9);
+      std::vector<std::tuple<char, char, int>> edges;
+      for (const auto& [src, dest, weight] : g.EdgesTo('c')) {
+        edges.emplace_back(src, dest, weight);
+      }
+      THEN("Only c's incoming edges are visited, ordered by source then weight") {
+        std::vector<std::tuple<char, char, int>> expected{
+            {'a', 'c', 4}, {'a', 'c', 5}, {'b', 'c', 2}, {'c', 'c', 9}};
+        REQUIRE(edges == expected);
+      }
+    }
+    WHEN("Nodes and edges are removed and replaced") {
+      g.erase('a', 'c', 4);
+      g.MergeReplace('b', 'a');
+      g.Replace('c', 'e');
+      THEN("The ranges follow the changes") {
+        std::vector<std::tuple<char, char, int>> to_e;
+        for (const auto& [src, dest, weight] : g.EdgesTo('e')) {
+          to_e.emplace_back(src, dest, weight);
+        }
+        std::vector<std::tuple<char, char, int>> expected{{'a', 'e', 2}, {'a', 'e', 5}};
+        REQUIRE(to_e == expected);
+        REQUIRE(g.EdgesTo('b').empty());
+      }
+    }
+    WHEN("The ranges of a node with no edges, or a value that isn't a node, are taken") {
+      THEN("They are empty") {
+        REQUIRE(g.EdgesFrom('d').empty());
+        REQUIRE(g.EdgesTo('d').empty());
+        REQUIRE(g.EdgesFrom('z').empty());
+      }
+    }
+  }
+}
+
+// Change log
+SCENARIO("A graph's changes can be streamed to a replica") {
+  GIVEN("A graph 'g' with a change log and a replica copied from it") {
+    std::vector<std::tuple<std::string, std::string, int>> e{{"a", "b", 1}, {"b", "c", 2}};
+    gdwg::Graph<std::string, int> g{e.begin(), e.end()};
+    g.EnableChangeLog();
+    gdwg::Graph<std::string, int> replica{g};
+    auto seen = g.ChangeSequence();
+    std::vector<std::uint64_t> notified;
+    g.Subscribe([&notified](const auto& delta) { notified.push_back(delta.sequence_); });
+    WHEN("g is changed with every kind of mutation") {
+      g.InsertNode("d");
+      g.InsertEdge("d", "a", 4);
+      g.InsertEdge("d", "a", 4);
+      g.erase("a", "b", 1);
+      g.Replace("c", "e");
+      g.MergeReplace("b", "e");
+      g.DeleteNode("x");
+      THEN("Only the successful mutations are recorded, in order") {
+        auto deltas = g.DeltasSince(seen);
+        REQUIRE(deltas.size() == 5);
+        REQUIRE(deltas[0].kind_ == gdwg::Graph<std::string, int>::Delta::Kind::kInsertNode);
+        REQUIRE(deltas[1].node_ == "d");
+        REQUIRE(*deltas[1].other_ == "a");
+        REQUIRE(*deltas[1].weight_ == 4);
+        REQUIRE(deltas[4].kind_ == gdwg::Graph<std::string, int>::Delta::Kind::kMergeReplace);
+        REQUIRE(g.ChangeSequence() == seen + 5);
+        REQUIRE(notified == std::vector<std::uint64_t>{1, 2, 3, 4, 5});
+      }
+      AND_THEN("Replaying the deltas onto the replica makes it equal to g") {
+        for (const auto& delta : g.DeltasSince(seen)) {
+          replica.ApplyDelta(delta);
+        }
+        REQUIRE(replica == g);
+        REQUIRE(g.DeltasSince(g.ChangeSequence()).empty());
+      }
+    }
+    WHEN("Changes are made in transactions that are rolled back and committed") {
+      {
+        gdwg::Graph<std::string, int>::Transaction tx{g};
+        g.InsertNode("lost");
+      }
+      {
+        gdwg::Graph<std::string, int>::Transaction tx{g};
+        g.InsertNode("kept");
+        g.clear();
+        tx.Commit();
+      }
+      THEN("Only the committed changes are recorded") {
+        auto deltas = g.DeltasSince(seen);
+        REQUIRE(deltas.size() == 2);
+        REQUIRE(deltas[0].node_ == "kept");
+        REQUIRE(deltas[1].kind_ == gdwg::Graph<std::string, int>::Delta::Kind::kClear);
+      }
+    }
+    WHEN("Deltas that have been read are trimmed") {
+      g.InsertNode("d");
+      g.InsertNode("e");
+      g.TrimChangeLog(seen + 1);
+      THEN("Later deltas can still be read, and trimmed ones cannot") {
+        REQUIRE(g.DeltasSince(seen + 1).size() == 1);
+        REQUIRE_THROWS_AS(g.DeltasSince(seen), std::out_of_range);
+      }
+    }
+    WHEN("g is cleared while a subscriber throws") {
+      g.Subscribe([](const auto&) { throw std::runtime_error("subscriber failed"); });
+      THEN("The exception reaches the caller and g is left unchanged") {
+        REQUIRE_THROWS_WITH(g.clear(), "subscriber failed");
+        REQUIRE(g.GetNodes() == std::vector<std::string>{"a", "b", "c"});
+        REQUIRE(g.IsConnected("a", "b"));
+      }
+    }
+    WHEN("g is move assigned onto a graph on a different resource") {
+      CountingResource resource;
+      gdwg::Graph<std::string, int> h{&resource};
+      h = std::move(g);
+      THEN("h takes g's change log without recording a clear") {
+        REQUIRE(h.GetNodes() == std::vector<std::string>{"a", "b", "c"});
+        REQUIRE(h.IsChangeLogEnabled());
+        REQUIRE(h.ChangeSequence() == seen);
+        REQUIRE(h.DeltasSince(seen).empty());
+        REQUIRE(notified.empty());
+      }
+    }
+  }
+  GIVEN("A graph without a change log") {
+    gdwg::Graph<int, int> g{1, 2};
+    THEN("No deltas can be read") {
+      REQUIRE(g.ChangeSequence() == 0);
+      REQUIRE_THROWS_WITH(g.DeltasSince(0),
+                          "Cannot call Graph::DeltasSince when the change log is disabled");
+    }
+  }
+}
+
+// Diffs
+SCENARIO("The differences between two graphs can be found and applied") {
+  GIVEN("An old and a new version of a graph") {
+    std::vector<std::tuple<std::string, std::string, int>> e1{
+        {"a", "b", 1}, {"a", "c", 2}, {"b", "c", 3}, {"c", "d", 4}};
+    std::vector<std::tuple<std::string, std::string, int>> e2{
+        {"a", "b", 1}, {"a", "c", 5}, {"b", "c", 3}, {"b", "e", 6}};
+    gdwg::Graph<std::string, int> old_graph{e1.begin(), e1.end()};
+    gdwg::Graph<std::string, int> new_graph{e2.begin(), e2.end()};
+    WHEN("The old graph is diffed against the new graph") {
+      auto patch = Diff(old_graph, new_graph);
+      THEN("Only the nodes and edges that changed are listed") {
+        REQUIRE(patch.removed_nodes_ == std::vector<std::string>{"d"});
+        REQUIRE(patch.added_nodes_ == std::vector<std::string>{"e"});
+        std::vector<std::tuple<std::string, std::string, int>> removed{{"a", "c", 2},
+                                                                       {"c", "d", 4}};
+        std::vector<std::tuple<std::string, std::string, int>> added{{"a", "c", 5},
+                                                                     {"b", "e", 6}};
+        REQUIRE(patch.removed_edges_ == removed);
+        REQUIRE(patch.added_edges_ == added);
+      }
+      AND_THEN("Applying the patch to the old graph turns it into the new graph") {
+        old_graph.ApplyPatch(patch);
+        REQUIRE(old_graph == new_graph);
+      }
+    }
+    WHEN("A graph is diffed against itself") {
+      auto patch = Diff(new_graph, new_graph);
+      THEN("The patch is empty") {
+        REQUIRE(patch.removed_nodes_.empty());
+        REQUIRE(patch.added_nodes_.empty());
+        REQUIRE(patch.removed_edges_.empty());
+        REQUIRE(patch.added_edges_.empty());
+      }
+    }
+  }
+}
+
+// A* search
+SCENARIO("Shortest paths can be found with A* search") {
+  GIVEN("A 4x4 grid graph with bidirectional edges and an expensive shortcut") {
+    // Node x * 10 + y sits at (x, y); moving one step costs 1
+    gdwg::Graph<int, double> g;
+    for (int x = 0; x < 4; ++x) {
+      for (int y = 0; y < 4; ++y) {
+        g.InsertNode(x * 10 + y);
+      }
+    }
+    for (int x = 0; x < 4; ++x) {
+      for (int y = 0; y < 4; ++y) {
+        if (x + 1 < 4) {
+          g.InsertEdge(x * 10 + y, (x + 1) * 10 + y, 1);
+          g.InsertEdge((x + 1) * 10 + y, x * 10 + y, 1);
+        }
+        if (y + 1 < 4) {
+          g.InsertEdge(x * 10 + y, x * 10 + y + 1, 1);
+          g.InsertEdge(x * 10 + y + 1, x * 10 + y, 1);
+        }
+      }
+    }
+    g.InsertEdge(0, 33, 10);
+    g.InsertNode(99);
+    auto manhattan = [](int goal) {
+      return [goal](int node) {
+        return static_cast<double>(std::abs(node / 10 - goal / 10) +
+                                   std::abs(node % 10 - goal % 10));
+      };
+    };
+    gdwg::Graph<int, double>::AStar astar{g};
+    WHEN("The path from corner to corner is searched for") {
+      auto cost = astar.Search(0, 33, manhattan(33));
+      THEN("The cheapest path is found, not the expensive shortcut") {
+        REQUIRE(cost.has_value());
+        REQUIRE(*cost == 6);
+        auto path = astar.Path();
+        REQUIRE(path.size() == 7);
+        REQUIRE(path.front() == 0);
+        REQUIRE(path.back() == 33);
+      }
+      AND_THEN("Later queries on the same AStar agree with a search without a heuristic") {
+        REQUIRE(astar.Search(31, 2, manhattan(2)) == astar.Search(31, 2, [](int) { return 0.0; }));
+        REQUIRE(*astar.Search(12, 12, manhattan(12)) == 0);
+        REQUIRE(astar.Path() == std::vector<int>{12});
+      }
+    }
+    WHEN("The destination can't be reached") {
+      auto cost = astar.Search(0, 99, [](int) { return 0.0; });
+      THEN("No cost or path is returned") {
+        REQUIRE_FALSE(cost.has_value());
+        REQUIRE(astar.Path().empty());
+      }
+    }
+    WHEN("A node that doesn't exist is searched for") {
+      THEN("A std::out_of_range is thrown") {
+        REQUIRE_THROWS_AS(astar.Search(0, 44, manhattan(44)), std::out_of_range);
+      }
+    }
+  }
+}
+
+SCENARIO("Communities can be detected with label propagation") {
+  GIVEN("Two cliques of four nodes joined by one light edge, and an isolated node") {
+    gdwg::Graph<int, double> g;
+    for (int i = 0; i < 9; ++i) {
+      g.InsertNode(i);
+    }
+    for (int a = 0; a < 4; ++a) {
+      for (int b = a + 1; b < 4; ++b) {
+        g.InsertEdge(a, b, 1);
+        g.InsertEdge(a + 4, b + 4, 1);
+      }
+    }
+    g.InsertEdge(3, 4, 0.5);
+    for (bool refine : {false, true}) {
+      WHEN((refine ? "Communities are detected and refined" : "Communities are detected")) {
+        auto communities = g.DetectCommunities(refine);
+        THEN("Each clique is its own community, and so is the isolated node") {
+          REQUIRE(communities.nodes_ == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8});
+          REQUIRE(communities.labels_ == std::vector<std::size_t>{0, 0, 0, 0, 1, 1, 1, 1, 2});
+          REQUIRE(communities.count_ == 3);
+          REQUIRE(communities.modularity_ > 0.4);
+          REQUIRE(communities.modularity_ < 0.5);
+        }
+      }
+    }
+  }
+  GIVEN("A ring of enough five node cliques to be shared between threads") {
+    constexpr int kCliques = 1000;
+    gdwg::Graph<int, int> g;
+    for (int i = 0; i < kCliques * 5; ++i) {
+      g.InsertNode(i);
+    }
+    for (int c = 0; c < kCliques; ++c) {
+      for (int a = 0; a < 5; ++a) {
+        for (int b = a + 1; b < 5; ++b) {
+          g.InsertEdge(c * 5 + a, c * 5 + b, 2);
+        }
+      }
+      g.InsertEdge(c * 5 + 4, (c + 1) % kCliques * 5, 1);
+    }
+    WHEN("Communities are detected with four threads") {
+      auto communities = g.DetectCommunities(true, 32, 4);
+      THEN("Every clique is a community") {
+        std::vector<std::size_t> expected;
+        for (int i = 0; i < kCliques * 5; ++i) {
+          expected.push_back(static_cast<std::size_t>(i / 5));
+        }
+        REQUIRE(communities.count_ == kCliques);
+        REQUIRE(communities.labels_ == expected);
+        REQUIRE(communities.modularity_ > 0.9);
+      }
+    }
+  }
+}
+
+SCENARIO("Edge lists can be ingested out of core into CSR files") {
+  using IntGraph = gdwg::Graph<int, int>;
+  // Bazel gives each test a scratch directory
+  const char* scratch = std::getenv("TEST_TMPDIR");
+  const std::string directory = scratch != nullptr ? scratch : ".";
+  const std::string edge_list = directory + "/graph_test_edges.txt";
+  const std::string csr = directory + "/graph_test_edges.csr";
+  GIVEN("An edge list of 3000 edges, with duplicates and self edges") {
+    std::vector<std::tuple<int, int, int>> tuples;
+    {
+      std::ofstream out{edge_list};
+      for (int i = 0; i < 3000; ++i) {
+        int src = (i * 7919) % 500;
+        int dest = (i * 104729) % 400;
+        int weight = i % 3;
+        out << src << ' ' << dest << ' ' << weight << '\n';
+        tuples.emplace_back(src, dest, weight);
+        if (i % 10 == 0) {
+          out << '\n' << src << '\t' << dest << ' ' << weight << '\n';
+        }
+      }
+    }
+    IntGraph expected{tuples.cbegin(), tuples.cend()};
+    WHEN("It is ingested with plenty of memory") {
+      auto stats = IntGraph::IngestEdgeList(edge_list, csr);
+      THEN("Nothing is spilled, and the loaded graph matches one built in memory") {
+        REQUIRE(stats.runs_ == 0);
+        REQUIRE(stats.nodes_ == expected.GetNodes().size());
+        REQUIRE(stats.edges_ == static_cast<std::size_t>(std::distance(expected.begin(),
+                                                                       expected.end())));
+        REQUIRE(IntGraph::LoadCsr(csr) == expected);
+      }
+    }
+    WHEN("It is ingested with a budget of a few hundred bytes") {
+      auto stats = IntGraph::IngestEdgeList(edge_list, csr, 512);
+      THEN("Many runs are spilled and merged, and the loaded graph is the same") {
+        REQUIRE(stats.runs_ > 64);
+        auto g = IntGraph::LoadCsr(csr);
+        REQUIRE(g == expected);
+        REQUIRE(g.GetConnected(0) == expected.GetConnected(0));
+      }
+    }
+  }
+  GIVEN("An edge list with a malformed line") {
+    {
+      std::ofstream out{edge_list};
+      out << "1 2 3\n4 five 6\n";
+    }
+    THEN("Ingesting it throws a std::runtime_error") {
+      REQUIRE_THROWS_AS(IntGraph::IngestEdgeList(edge_list, csr), std::runtime_error);
+    }
+  }
+  GIVEN("Files that don't exist or aren't CSR files") {
+    THEN("A std::runtime_error is thrown") {
+      REQUIRE_THROWS_AS(IntGraph::IngestEdgeList(directory + "/missing.txt", csr),
+                        std::runtime_error);
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(directory + "/missing.csr"),
+                        std::runtime_error);
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(edge_list), std::runtime_error);
+    }
+  }
+  GIVEN("CSR files with corrupt headers, or nodes or edges out of order") {
+    auto write_csr = [&csr](std::uint64_t node_count, std::uint64_t edge_count,
+                            const std::vector<int>& nodes,
+                            const std::vector<std::uint64_t>& offsets,
+                            const std::vector<std::uint64_t>& targets,
+                            const std::vector<int>& weights) {
+      std::ofstream out{csr, std::ios::binary};
+      out.write(gdwg::csr::kMagic, sizeof(gdwg::csr::kMagic));
+      for (std::uint64_t field : {std::uint64_t{sizeof(int)}, std::uint64_t{sizeof(int)},
+                                  node_count, edge_count}) {
+        out.write(reinterpret_cast<const char*>(&field), sizeof(field));
+      }
+      out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(int));
+      out.write(reinterpret_cast<const char*>(offsets.data()),
+                offsets.size() * sizeof(std::uint64_t));
+      out.write(reinterpret_cast<const char*>(targets.data()),
+                targets.size() * sizeof(std::uint64_t));
+      out.write(reinterpret_cast<const char*>(weights.data()), weights.size() * sizeof(int));
+    };
+    THEN("Counts larger than the file throw a std::runtime_error") {
+      write_csr(std::uint64_t{1} << 60, 0, {}, {}, {}, {});
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(csr), std::runtime_error);
+      write_csr(1, std::uint64_t{1} << 60, {1}, {0, 0}, {}, {});
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(csr), std::runtime_error);
+    }
+    THEN("Duplicate or unsorted nodes throw a std::runtime_error") {
+      write_csr(3, 0, {5, 1, 5}, {0, 0, 0, 0}, {}, {});
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(csr), std::runtime_error);
+      write_csr(2, 0, {5, 5}, {0, 0, 0}, {}, {});
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(csr), std::runtime_error);
+    }
+    THEN("Only edges in increasing (target, weight) order are loaded") {
+      write_csr(2, 2, {1, 2}, {0, 2, 2}, {1, 1}, {3, 4});
+      REQUIRE(IntGraph::LoadCsr(csr).GetWeights(1, 2) == std::vector<int>{3, 4});
+      write_csr(2, 2, {1, 2}, {0, 2, 2}, {1, 1}, {3, 3});
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(csr), std::runtime_error);
+      write_csr(2, 2, {1, 2}, {0, 2, 2}, {1, 0}, {3, 4});
+      REQUIRE_THROWS_AS(IntGraph::LoadCsr(csr), std::runtime_error);
+    }
+  }
+  std::remove(edge_list.c_str());
+  std::remove(csr.c_str());
+}
+
+SCENARIO("Graphs can be partitioned into balanced shards") {
+  GIVEN("Two cliques of four nodes joined by one edge") {
+    gdwg::Graph<int, int> g;
+    for (int i = 0; i < 8; ++i) {
+      g.InsertNode(i);
+    }
+    for (int a = 0; a < 4; ++a) {
+      for (int b = a + 1; b < 4; ++b) {
+        g.InsertEdge(a, b, 1);
+        g.InsertEdge(b + 4, a + 4, 2);
+      }
+    }
+    g.InsertEdge(3, 4, 5);
+    WHEN("It is partitioned into two shards") {
+      auto partition = g.PartitionNodes(2);
+      THEN("Each clique is a shard, cutting only the joining edge") {
+        REQUIRE(partition.nodes_ == g.GetNodes());
+        REQUIRE(partition.shards_[0] != partition.shards_[4]);
+        for (int i = 0; i < 8; ++i) {
+          REQUIRE(partition.shards_[i] == partition.shards_[i < 4 ? 0 : 4]);
+        }
+        REQUIRE(partition.edge_cut_ == 1);
+        REQUIRE(partition.shard_sizes_ == std::vector<std::size_t>{4, 4});
+        REQUIRE(partition.balance_ == 1);
+      }
+      AND_THEN("Each shard can be extracted along with its boundary") {
+        auto shard = g.ExtractShard(partition, partition.shards_[4]);
+        REQUIRE(shard.graph_.GetNodes() == std::vector<int>{4, 5, 6, 7});
+        REQUIRE(shard.graph_.GetConnected(7) == std::vector<int>{4, 5, 6});
+        REQUIRE(shard.graph_.IsConnected(7, 4));
+        REQUIRE(shard.boundary_ == std::vector<int>{4});
+        REQUIRE(shard.cut_edges_ == std::vector<std::tuple<int, int, int>>{{3, 4, 5}});
+        REQUIRE(g.ExtractShard(partition, partition.shards_[0]).graph_.GetConnected(3) ==
+                std::vector<int>{});
+      }
+      AND_THEN("Extracting a shard that doesn't exist throws a std::out_of_range") {
+        REQUIRE_THROWS_AS(g.ExtractShard(partition, 2), std::out_of_range);
+      }
+    }
+  }
+  GIVEN("A 20x20 grid") {
+    gdwg::Graph<int, int> g;
+    for (int i = 0; i < 400; ++i) {
+      g.InsertNode(i);
+    }
+    for (int i = 0; i < 400; ++i) {
+      if (i % 20 != 19) {
+        g.InsertEdge(i, i + 1, 1);
+      }
+      if (i < 380) {
+        g.InsertEdge(i, i + 20, 1);
+      }
+    }
+    WHEN("It is partitioned into four shards") {
+      auto partition = g.PartitionNodes(4);
+      THEN("The shards are balanced and cut far fewer edges than hashing would") {
+        REQUIRE(partition.balance_ <= 1.1);
+        // Hashing nodes into four shards cuts about three quarters of the 760 edges
+        REQUIRE(partition.edge_cut_ < 760 / 4);
+        std::size_t nodes = 0;
+        for (std::size_t s = 0; s < 4; ++s) {
+          auto shard = g.ExtractShard(partition, s);
+          nodes += shard.graph_.GetNodes().size();
+          REQUIRE(shard.graph_.GetNodes().size() == partition.shard_sizes_[s]);
+        }
+        REQUIRE(nodes == 400);
+      }
+    }
+  }
+  GIVEN("A graph") {
+    gdwg::Graph<int, int> g{1, 2, 3};
+    THEN("Partitioning it into no shards throws a std::runtime_error") {
+      REQUIRE_THROWS_AS(g.PartitionNodes(0), std::runtime_error);
+    }
+  }
+}
+
+SCENARIO("k-hop neighbourhoods can be found for many seeds at once") {
+  GIVEN("A chain 1 -> 2 -> 3 -> 4 with a cycle back to 1 and a branch 2 -> 5") {
+    gdwg::Graph<int, int> g{1, 2, 3, 4, 5};
+    g.InsertEdge(1, 2, 0);
+    g.InsertEdge(2, 3, 0);
+    g.InsertEdge(3, 4, 0);
+    g.InsertEdge(4, 1, 0);
+    g.InsertEdge(2, 5, 0);
+    WHEN("The 2-hop neighbourhoods of 1, 4 and 5 are found") {
+      auto hoods = g.KHopNeighbourhoods({1, 4, 5}, 2);
+      THEN("Each lists the nodes 1 or 2 edges away, sorted, without the seed") {
+        REQUIRE(hoods.offsets_ == std::vector<std::size_t>{0, 3, 5, 5});
+        REQUIRE(hoods.nodes_ == std::vector<int>{2, 3, 5, 1, 2});
+      }
+    }
+    WHEN("The 0-hop neighbourhood is found") {
+      THEN("It is empty") {
+        REQUIRE(g.KHopNeighbourhoods({1}, 0).nodes_.empty());
+      }
+    }
+    WHEN("A seed doesn't exist") {
+      THEN("A std::out_of_range is thrown") {
+        REQUIRE_THROWS_AS(g.KHopNeighbourhoods({1, 6}, 2), std::out_of_range);
+      }
+    }
+  }
+  GIVEN("A graph of 200 nodes and more seeds than fit in one batch") {
+    gdwg::Graph<int, int> g;
+    for (int i = 0; i < 200; ++i) {
+      g.InsertNode(i);
+    }
+    for (int i = 0; i < 200; ++i) {
+      g.InsertEdge(i, (i * 7 + 3) % 200, 0);
+      g.InsertEdge(i, (i * 13 + 5) % 200, 0);
+    }
+    std::vector<int> seeds;
+    for (int i = 0; i < 150; ++i) {
+      seeds.push_back((i * 37) % 200);
+    }
+    WHEN("The 3-hop neighbourhoods are found") {
+      auto hoods = g.KHopNeighbourhoods(seeds, 3);
+      THEN("They match a breadth first search from each seed") {
+        REQUIRE(hoods.offsets_.size() == seeds.size() + 1);
+        for (std::size_t i = 0; i < seeds.size(); ++i) {
+          std::set<int> reached;
+          std::vector<int> frontier{seeds[i]};
+          for (int hop = 0; hop < 3; ++hop) {
+            std::vector<int> next;
+            for (int node : frontier) {
+              for (int neighbour : g.GetConnected(node)) {
+                if (neighbour != seeds[i] && reached.insert(neighbour).second) {
+                  next.push_back(neighbour);
+                }
+              }
+            }
+            frontier = next;
+          }
+          std::vector<int> found(hoods.nodes_.begin() + hoods.offsets_[i],
+                                 hoods.nodes_.begin() + hoods.offsets_[i + 1]);
+          REQUIRE(found == std::vector<int>(reached.begin(), reached.end()));
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Node degrees can be queried without scanning the edges") {
+  using Degree = gdwg::Graph<std::string, int>::Degree;
+  // Recounts the histogram the slow way, to check the maintained one against
+  auto recount = [](const gdwg::Graph<std::string, int>& g, Degree kind) {
+    std::vector<std::size_t> histogram;
+    for (const auto& node : g.GetNodes()) {
+      auto degree = static_cast<std::size_t>(kind == Degree::kIn ? g.GetInDegree(node)
+                                                                 : g.GetOutDegree(node));
+      histogram.resize(std::max(histogram.size(), degree + 1), 0);
+      ++histogram[degree];
+    }
+    return histogram;
+  };
+  GIVEN("A graph with a hub and a self edge") {
+    std::vector<std::tuple<std::string, std::string, int>> edges{
+        {"hub", "a", 1}, {"hub", "b", 1}, {"hub", "c", 1}, {"a", "hub", 1},
+        {"b", "c", 2},   {"c", "c", 3},   {"c", "c", 4}};
+    gdwg::Graph<std::string, int> g{edges.cbegin(), edges.cend()};
+    g.InsertNode("lonely");
+    THEN("Each node's degrees are reported") {
+      REQUIRE(g.GetOutDegree("hub") == 3);
+      REQUIRE(g.GetInDegree("hub") == 1);
+      REQUIRE(g.GetInDegree("c") == 4);
+      REQUIRE(g.GetOutDegree("lonely") == 0);
+      REQUIRE_THROWS_AS(g.GetInDegree("missing"), std::out_of_range);
+    }
+    THEN("The histograms and the top nodes follow from them") {
+      REQUIRE(g.GetDegreeHistogram(Degree::kOut) == std::vector<std::size_t>{1, 2, 1, 1});
+      REQUIRE(g.GetDegreeHistogram(Degree::kIn) == std::vector<std::size_t>{1, 3, 0, 0, 1});
+      REQUIRE(g.TopByDegree(2, Degree::kOut) == std::vector<std::string>{"hub", "c"});
+      REQUIRE(g.TopByDegree(3, Degree::kIn) == std::vector<std::string>{"c", "a", "b"});
+      REQUIRE(g.TopByDegree(10, Degree::kIn).size() == 5);
+      REQUIRE(g.TopByDegree(0, Degree::kIn).empty());
+    }
+    WHEN("The graph is changed in every way") {
+      g.erase("c", "c", 3);
+      g.DeleteNode("a");
+      g.MergeReplace("b", "lonely");
+      g.Replace("hub", "centre");
+      {
+        gdwg::Graph<std::string, int>::Transaction tx{g};
+        g.InsertEdge("c", "centre", 5);
+        g.DeleteNode("centre");
+        g.clear();
+      }
+      auto copy = g;
+      THEN("The histograms stay in step with the degrees") {
+        REQUIRE(g.GetOutDegree("centre") == 2);
+        REQUIRE(g.GetInDegree("c") == 3);
+        for (auto kind : {Degree::kIn, Degree::kOut}) {
+          REQUIRE(g.GetDegreeHistogram(kind) == recount(g, kind));
+          REQUIRE(copy.GetDegreeHistogram(kind) == recount(g, kind));
+        }
+        REQUIRE(g.TopByDegree(1, Degree::kIn) == std::vector<std::string>{"c"});
+      }
+      AND_WHEN("It is cleared") {
+        g.clear();
+        THEN("The histograms are empty") {
+          REQUIRE(g.GetDegreeHistogram(Degree::kIn).empty());
+          REQUIRE(g.TopByDegree(3, Degree::kOut).empty());
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Concurrent graphs publish new versions to readers that never block") {
+  GIVEN("A concurrent graph holding one node") {
+    gdwg::ConcurrentGraph<int, int> shared{gdwg::Graph<int, int>{0}};
+    WHEN("A reader holds a snapshot across an update") {
+      auto before = shared.Read();
+      auto version = shared.Update([](gdwg::Graph<int, int>& g) {
+        g.InsertNode(1);
+        g.InsertEdge(0, 1, 7);
+      });
+      THEN("The snapshot is unchanged, and new readers see the update") {
+        REQUIRE(version == 1);
+        REQUIRE(before.Version() == 0);
+        REQUIRE(before->GetNodes() == std::vector<int>{0});
+        auto after = shared.Read();
+        REQUIRE(after.Version() == 1);
+        REQUIRE(after->IsConnected(0, 1));
+      }
+      THEN("The old version is only reclaimed once the snapshot is released") {
+        REQUIRE(shared.Retired() == 1);
+        before = shared.Read();
+        shared.Reclaim();
+        REQUIRE(shared.Retired() == 0);
+      }
+    }
+    WHEN("An update throws") {
+      THEN("Nothing is published") {
+        REQUIRE_THROWS_AS(shared.Update([](gdwg::Graph<int, int>& g) { g.InsertEdge(0, 5, 1); }),
+                          std::runtime_error);
+        REQUIRE(shared.Read().Version() == 0);
+      }
+    }
+  }
+  GIVEN("Readers running alongside a writer that grows a chain") {
+    gdwg::ConcurrentGraph<int, int> shared{gdwg::Graph<int, int>{0}, 4};
+    std::atomic<bool> done{false};
+    std::atomic<bool> consistent{true};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 6; ++r) {
+      readers.emplace_back([&] {
+        while (!done) {
+          auto snapshot = shared.Read();
+          // Version v holds the chain 0 -> 1 -> ... -> v
+          auto nodes = snapshot->GetNodes();
+          if (nodes.size() != snapshot.Version() + 1 ||
+              std::distance(snapshot->begin(), snapshot->end()) !=
+                  static_cast<std::ptrdiff_t>(snapshot.Version())) {
+            consistent = false;
+          }
+        }
+      });
+    }
+    for (int i = 1; i <= 200; ++i) {
+      shared.Update([i](gdwg::Graph<int, int>& g) {
+        g.InsertNode(i);
+        g.InsertEdge(i - 1, i, 0);
+      });
+    }
+    done = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    THEN("Every snapshot read was a whole version, and every old version is reclaimed") {
+      REQUIRE(consistent);
+      REQUIRE(shared.Read()->GetNodes().size() == 201);
+      shared.Reclaim();
+      REQUIRE(shared.Retired() == 0);
+    }
+  }
+}
+
+SCENARIO("Edge lists can be parsed straight into a graph") {
+  const char* scratch = std::getenv("TEST_TMPDIR");
+  const std::string path =
+      std::string{scratch != nullptr ? scratch : "."} + "/graph_test_parse.txt";
+  GIVEN("An edge list of named nodes, with duplicates, blank lines and CRLF endings") {
+    std::vector<std::tuple<std::string, std::string, double>> tuples;
+    {
+      std::ofstream out{path};
+      for (int i = 0; i < 500; ++i) {
+        auto src = "node" + std::to_string(i % 37);
+        auto dest = "node" + std::to_string((i * 11) % 53);
+        double weight = (i % 4) * 0.5;
+        out << src << "  " << dest << '\t' << weight << (i % 3 == 0 ? "\r\n" : "\n");
+        tuples.emplace_back(src, dest, weight);
+        if (i % 50 == 0) {
+          out << "\n   \n" << src << ' ' << dest << ' ' << weight << '\n';
+        }
+      }
+    }
+    gdwg::Graph<std::string, double> expected{tuples.cbegin(), tuples.cend()};
+    for (unsigned threads : {1u, 3u, 8u}) {
+      WHEN("It is parsed with " + std::to_string(threads) + " threads") {
+        auto g = gdwg::Graph<std::string, double>::ParseEdgeList(path, threads);
+        THEN("The graph matches one built from tuples") {
+          REQUIRE(g == expected);
+          REQUIRE(g.GetOutDegree("node0") == expected.GetOutDegree("node0"));
+        }
+      }
+    }
+  }
+  GIVEN("An edge list of numbered nodes, some written with leading zeros") {
+    {
+      std::ofstream out{path};
+      out << "1 2 3\n01 2 3\n2 007 -4\n7 7 1";
+    }
+    WHEN("It is parsed") {
+      auto g = gdwg::Graph<int, int>::ParseEdgeList(path, 2);
+      THEN("Equal numbers are the same node") {
+        REQUIRE(g.GetNodes() == std::vector<int>{1, 2, 7});
+        REQUIRE(g.GetWeights(1, 2) == std::vector<int>{3});
+        REQUIRE(g.GetWeights(2, 7) == std::vector<int>{-4});
+        REQUIRE(g.IsConnected(7, 7));
+      }
+    }
+  }
+  GIVEN("Edge lists that can't be parsed") {
+    using IntGraph = gdwg::Graph<int, int>;
+    THEN("A std::runtime_error is thrown") {
+      for (const auto* text : {"1 2 3\n1 2\n", "1 2 3 4\n", "1 two 3\n", "1 2 3.5\n"}) {
+        {
+          std::ofstream out{path};
+          out << text;
+        }
+        REQUIRE_THROWS_AS(IntGraph::ParseEdgeList(path), std::runtime_error);
+      }
+      REQUIRE_THROWS_AS(IntGraph::ParseEdgeList(path + ".missing"), std::runtime_error);
+    }
+  }
+  std::remove(path.c_str());
+}
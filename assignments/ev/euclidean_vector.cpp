@@ -1,19 +1,18 @@
 #include "assignments/ev/euclidean_vector.h"
 
 #include <algorithm>
+#include <cstring>
+
+#include "assignments/ev/euclidean_vector_kernels.h"
 
 /********************* CONSTRUCTORS *************************************/
 // The default constructor of EuclideanVector.
 // The default constructor assigns the arguments x and y to the class members
-// num_dimensions_ and magnitudes_ respectively. A unique pointer is assigned to 
-// a c-style array of double, of length x, and is assigned all values of y.
+// num_dimensions_ and the magnitudes respectively. Storage for x magnitudes is
+// allocated (see Allocate), and every magnitude is assigned the value y.
 EuclideanVector::EuclideanVector(int x, double y) noexcept{
-  this->num_dimensions_ = x;
-  this->magnitudes_ = std::make_unique<double[]>(x);
-
-  for (int i = 0; i != x; ++i) {
-    magnitudes_[i] = y;
-  }
+  this->Allocate(x);
+  std::fill(this->Magnitudes(), this->Magnitudes() + x, y);
 }
 
 // An alternate constructor of the EuclideanVector Class.
@@ -24,49 +23,41 @@ EuclideanVector::EuclideanVector(std::vector<double>::const_iterator start,
                                  std::vector<double>::const_iterator finish) noexcept{
   // if the vector is empty, construct an EV with 1 dimension with a magnitude of 0
   if (start == finish) {
-    this->num_dimensions_ = 1;
-    this->magnitudes_ = std::make_unique<double[]>(1);
-    this->magnitudes_.get()[0] = 0.0;
+    this->Allocate(1);
+    this->Magnitudes()[0] = 0.0;
   } else {
-    std::vector<double> to_vector;
-    std::copy(start, finish, std::back_inserter(to_vector));
-
-    this->magnitudes_ = std::make_unique<double[]>(to_vector.size());
-    this->num_dimensions_ = to_vector.size();
-    for (int i = 0; i != num_dimensions_; ++i) {
-      magnitudes_[i] = to_vector[i];
-    }
+    this->Allocate(static_cast<int>(finish - start));
+    std::copy(start, finish, this->Magnitudes());
   }
 }
 
 // Returns a deep copy of a EuclideanVector.
-// A new c-style array of magnitudes with size equal to the input EV is allocated
+// Storage for as many magnitudes as the input EV has is allocated, and they are copied across
 EuclideanVector::EuclideanVector(const EuclideanVector& original) noexcept{
-  this->num_dimensions_ = original.num_dimensions_;
-  this->magnitudes_ = std::make_unique<double[]>(original.num_dimensions_);
-  for (int i = 0; i < original.num_dimensions_; i++) {
-    this->magnitudes_.get()[i] = original.magnitudes_.get()[i];
-  }
+  this->Allocate(original.num_dimensions_);
+  std::copy(original.Magnitudes(), original.Magnitudes() + original.num_dimensions_,
+            this->Magnitudes());
+  this->CopyNormCache(original);
 }
 
 // Returns a copy of the target EV, and puts the target EV into a valid but
-// unspecified state with 0 dimensions and deallocates the magnitudes_ array
+// unspecified state with 0 dimensions. A heap array is taken over by the new EV,
+// while magnitudes stored inline are copied.
 EuclideanVector::EuclideanVector(EuclideanVector&& original) noexcept {
-  this->magnitudes_ = std::move(original.magnitudes_);
-  this->num_dimensions_ = original.num_dimensions_;
-  original.num_dimensions_ = 0;
+  this->TakeMagnitudes(original);
 }
 
 /********************* METHODS *************************************/
 
-// Returns the magnitude in the [index] position of the magnitudes_ array.
+// Returns the magnitude in the [index] position of the magnitudes.
 // Throws an EuclideanVectorException exception if the [index] is out of bounds of the EV.
-double& EuclideanVector::at(const int& index) {
+// The magnitude is returned through a MagnitudeReference, so that setting it clears the norm cache.
+EuclideanVector::MagnitudeReference EuclideanVector::at(const int& index) {
   if (index < 0 || index >= this->num_dimensions_) {
     std::string error_message = "Index " + std::to_string(index) + " is not valid for this EuclideanVector object";
     throw EuclideanVectorError(error_message);
   }
-  return this->magnitudes_.get()[index];
+  return MagnitudeReference{*this, this->Magnitudes()[index]};
 }
 
 // As the above function, but is used for const EuclideanVector(s) that cannot be changed
@@ -74,20 +65,28 @@ double EuclideanVector::at(const int& index) const{
   if (index < 0 || index >= this->num_dimensions_) {
     throw EuclideanVectorError("Index X is not valid for this EuclideanVector object");
   }
-  return this->magnitudes_.get()[index];
+  return this->Magnitudes()[index];
 }
 
 // Returns a value which is normal of the EV given by the root of the sum of squares
-// of its magnitudes.
+// of its magnitudes. The sum of squares is within the tolerance documented in
+// euclidean_vector_kernels.h of the exact sum.
+// The norm is only computed the first time it's asked for after the EV changes.
 double EuclideanVector::GetEuclideanNorm() const{
   if (this->num_dimensions_ == 0) {
     throw EuclideanVectorError("EuclideanVector with no dimensions does not have a norm");
   }
-  double sum_of_squares = 0;
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    sum_of_squares += std::pow(this->magnitudes_.get()[i], 2);
+  std::uint64_t bits = this->norm_cache_.load(std::memory_order_relaxed);
+  double norm;
+  if (bits == kNoNorm) {
+    norm = std::sqrt(ev_kernels::Active().sum_of_squares_(this->Magnitudes(),
+                                                          this->num_dimensions_));
+    std::memcpy(&bits, &norm, sizeof(bits));
+    this->norm_cache_.store(bits, std::memory_order_relaxed);
+  } else {
+    std::memcpy(&norm, &bits, sizeof(norm));
   }
-  return std::sqrt(sum_of_squares);
+  return norm;
 }
 
 // Returns a new EuclideanVector that is the unit vector of the target EV.
@@ -96,111 +95,43 @@ EuclideanVector EuclideanVector::CreateUnitVector() const{
   if (this->num_dimensions_ == 0) {
     throw EuclideanVectorError("EuclideanVector with no dimensions does not have a unit vector");
   }
-  if (this->GetEuclideanNorm() == 0) {
+  double norm = this->GetEuclideanNorm();
+  if (norm == 0) {
     throw EuclideanVectorError(
         "EuclideanVector with euclidean normal of 0 does not have a unit vector");
   }
-  std::vector<double> to_vector;
-  to_vector.reserve(this->num_dimensions_);
-  double unit = this->GetEuclideanNorm();
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    to_vector.push_back((this->magnitudes_.get()[i]) / unit);
-  }
-  return EuclideanVector(to_vector.begin(), to_vector.end());
+  EuclideanVector unit_vector{this->num_dimensions_};
+  ev_kernels::Active().divide_(this->Magnitudes(), norm, unit_vector.Magnitudes(),
+                               this->num_dimensions_);
+  return unit_vector;
 }
 
 /********************* FRIEND OVERLOADS *************************************/
 
-// Operator overload of + to add two EVs together.
-// The function will throw a EuclideanVectorError exception if the dimensions of each EV arent equal.
-// The alternate constructor is used to return an EV as a new vector<double> is created
-// within the function that contains the element by element summation of each magnitude.
-EuclideanVector operator+(const EuclideanVector& lhs, const EuclideanVector& rhs) {
-  if (lhs.num_dimensions_ != rhs.num_dimensions_) {
-    std::string error_message = "Dimensions of LHS(" + std::to_string(lhs.num_dimensions_) +
-                                ") and RHS(" + std::to_string(rhs.num_dimensions_) +
-                                ") do not match";
-    throw EuclideanVectorError(error_message);
-  }
-  std::vector<double> to_vector;
-  to_vector.reserve(lhs.num_dimensions_);
-  for (int i = 0; i < lhs.num_dimensions_; i++) {
-    to_vector.push_back(lhs.magnitudes_.get()[i] + rhs.magnitudes_.get()[i]);
-  }
-  return EuclideanVector{to_vector.begin(), to_vector.end()};
-}
+// Operators +, -, * and / build expression templates, see euclidean_vector.tpp
 
-// Dot product multiplication overloaded operator *.
-// The function will throw a EuclideanVectorError exception if the dimensions of each EV arent equal.
-// Returns the summation of each element by element multiplication of two EVs.
-double operator*(const EuclideanVector& lhs, const EuclideanVector& rhs) {
-  if (lhs.num_dimensions_ != rhs.num_dimensions_) {
-    std::string error_message = "Dimensions of LHS(" + std::to_string(lhs.num_dimensions_) +
-                                ") and RHS(" + std::to_string(rhs.num_dimensions_) +
-                                ") do not match";
-    throw EuclideanVectorError(error_message);
-  }
-  double sum = 0;
-  for (int i = 0; i < lhs.num_dimensions_; i++) {
-    sum = sum + (lhs.magnitudes_.get()[i] * rhs.magnitudes_.get()[i]);
-  }
-  return sum;
+// Overloads of the operators above for an expiring EuclideanVector operand, whose magnitudes
+// are overwritten with the result and moved into the returned EV, see euclidean_vector.h
+EuclideanVector operator+(EuclideanVector&& lhs, EuclideanVector&& rhs) {
+  return std::move(lhs) + static_cast<const VectorExpression<EuclideanVector>&>(rhs);
 }
 
-// Scalar product multiplication of an EV and a double using overloaded operator *.
-// The alternate constructor is used to return an EV as a new vector<double> is created
-// within the function that contains the element by element product of each magnitude with the input scalar value.
-EuclideanVector operator*(const EuclideanVector& ev, const double& scalar) noexcept{
-  std::vector<double> to_vector;
-  to_vector.reserve(ev.num_dimensions_);
-  for (int i = 0; i < ev.num_dimensions_; i++) {
-    to_vector.push_back(ev.magnitudes_.get()[i] * scalar);
-  }
-  return EuclideanVector{to_vector.begin(), to_vector.end()};
+EuclideanVector operator-(EuclideanVector&& lhs, EuclideanVector&& rhs) {
+  return std::move(lhs) - static_cast<const VectorExpression<EuclideanVector>&>(rhs);
 }
 
-// As the above function, but accounts for the multiplicand on the other side of the EV
-EuclideanVector operator*(const double& scalar, const EuclideanVector& ev) noexcept{
-  std::vector<double> to_vector;
-  to_vector.reserve(ev.num_dimensions_);
-  for (int i = 0; i < ev.num_dimensions_; i++) {
-    to_vector.push_back(ev.magnitudes_.get()[i] * scalar);
-  }
-  return EuclideanVector{to_vector.begin(), to_vector.end()};
+EuclideanVector operator*(EuclideanVector&& ev, const double& scalar) noexcept {
+  ev *= scalar;
+  return ev.GetNumDimensions() == 0 ? EuclideanVector{} : std::move(ev);
 }
 
-// Scalar division of an EV.
-// The alternate constructor is used to return an EV as a new vector<double> is created
-// within the function that contains the element by element division of each magnitude with the input scalar value. 
-EuclideanVector operator/(const EuclideanVector& ev, const double& scalar) {
-  if (scalar == 0) {
-    throw EuclideanVectorError("Invalid vector division by 0");
-  }
-  std::vector<double> to_vector;
-  to_vector.reserve(ev.num_dimensions_);
-  for (int i = 0; i < ev.num_dimensions_; i++) {
-    to_vector.push_back(ev.magnitudes_.get()[i] / scalar);
-  }
-  return EuclideanVector{to_vector.begin(), to_vector.end()};
+EuclideanVector operator*(const double& scalar, EuclideanVector&& ev) noexcept {
+  return std::move(ev) * scalar;
 }
 
-// Scalar subtraction of an EV.
-// The function will throw a EuclideanVectorError exception if the dimensions of each EV arent equal.
-// The alternate constructor is used to return an EV as a new vector<double> is created
-// within the function that contains the element by element subtraction between two EVs.
-EuclideanVector operator-(const EuclideanVector& lhs, const EuclideanVector& rhs) {
-  if (lhs.num_dimensions_ != rhs.num_dimensions_) {
-    std::string error_message = "Dimensions of LHS(" + std::to_string(lhs.num_dimensions_) +
-                                ") and RHS(" + std::to_string(rhs.num_dimensions_) +
-                                ") do not match";
-    throw EuclideanVectorError(error_message);
-  }
-  std::vector<double> to_vector;
-  to_vector.reserve(lhs.num_dimensions_);
-  for (int i = 0; i < lhs.num_dimensions_; i++) {
-    to_vector.push_back(lhs.magnitudes_.get()[i] - rhs.magnitudes_.get()[i]);
-  }
-  return EuclideanVector{to_vector.begin(), to_vector.end()};
+EuclideanVector operator/(EuclideanVector&& ev, const double& scalar) {
+  ev /= scalar;
+  return ev.GetNumDimensions() == 0 ? EuclideanVector{} : std::move(ev);
 }
 
 // Returns an output stream that can be used to display an EV through std::cout
@@ -213,9 +144,9 @@ std::ostream& operator<<(std::ostream& os, const EuclideanVector& ev) noexcept{
   }
   for (int i = 0; i < ev.num_dimensions_; i++) {
     if (i == ev.num_dimensions_ - 1) {
-      os << ev.magnitudes_.get()[i] << "]";
+      os << ev.Magnitudes()[i] << "]";
     } else {
-      os << ev.magnitudes_.get()[i] << " ";
+      os << ev.Magnitudes()[i] << " ";
     }
   }
   return os;
@@ -223,13 +154,13 @@ std::ostream& operator<<(std::ostream& os, const EuclideanVector& ev) noexcept{
 
 // Overloaded operator of == for two EVs.
 // Returns true if both sides of the == operator have the same num_dimensions_ and if
-// each element[n] in their magnitudes_ array is equal. Returns false otherwise.
+// each element[n] in their magnitudes is equal. Returns false otherwise.
 bool operator==(const EuclideanVector& lhs, const EuclideanVector& rhs) noexcept {
   if (lhs.num_dimensions_ != rhs.num_dimensions_) {
     return false;
   }
   for (int i = 0; i < lhs.num_dimensions_; i++) {
-    if (lhs.magnitudes_.get()[i] != rhs.magnitudes_.get()[i]) {
+    if (lhs.Magnitudes()[i] != rhs.Magnitudes()[i]) {
       return false;
     }
   }
@@ -238,14 +169,14 @@ bool operator==(const EuclideanVector& lhs, const EuclideanVector& rhs) noexcept
 
 // Overloaded operator of != for two EVs.
 // Returns true if both sides of the != operator have different num_dimensions_.
-// The function will also return true if each element[n] in their magnitudes_ array is not equal.
+// The function will also return true if each element[n] in their magnitudes is not equal.
 // Returns false otherwise.
 bool operator!=(const EuclideanVector& lhs, const EuclideanVector& rhs) noexcept {
   if (lhs.num_dimensions_ != rhs.num_dimensions_) {
     return true;
   }
   for (int i = 0; i < lhs.num_dimensions_; i++) {
-    if (lhs.magnitudes_.get()[i] == rhs.magnitudes_.get()[i]) {
+    if (lhs.Magnitudes()[i] == rhs.Magnitudes()[i]) {
       return false;
     }
   }
@@ -264,9 +195,9 @@ EuclideanVector& EuclideanVector::operator+=(const EuclideanVector& ev) {
                                 ") do not match";
     throw EuclideanVectorError(error_message);
   }
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    this->magnitudes_.get()[i] = this->magnitudes_.get()[i] + ev.magnitudes_.get()[i];
-  }
+  this->ClearNormCache();
+  ev_kernels::Active().add_(this->Magnitudes(), ev.Magnitudes(), this->Magnitudes(),
+                            this->num_dimensions_);
   return *this;
 }
 
@@ -280,19 +211,18 @@ EuclideanVector& EuclideanVector::operator-=(const EuclideanVector& ev) {
                                 ") do not match";
     throw EuclideanVectorError(error_message);
   }
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    this->magnitudes_.get()[i] = this->magnitudes_.get()[i] - ev.magnitudes_.get()[i];
-  }
+  this->ClearNormCache();
+  ev_kernels::Active().subtract_(this->Magnitudes(), ev.Magnitudes(),
+                                 this->Magnitudes(), this->num_dimensions_);
   return *this;
 }
 
 // Operator overload of *= to multiply an EV with a scalar value.
 // The original EV is overwritten.
 EuclideanVector& EuclideanVector::operator*=(const double& scalar) noexcept{
-  std::vector<double> to_vector;
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    this->magnitudes_.get()[i] = this->magnitudes_.get()[i] * scalar;
-  }
+  this->ClearNormCache();
+  ev_kernels::Active().scale_(this->Magnitudes(), scalar, this->Magnitudes(),
+                              this->num_dimensions_);
   return *this;
 }
 
@@ -302,71 +232,96 @@ EuclideanVector& EuclideanVector::operator/=(const double& scalar) {
   if (scalar == 0) {
     throw EuclideanVectorError("Invalid vector division by 0");
   }
-  std::vector<double> to_vector;
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    this->magnitudes_.get()[i] = this->magnitudes_.get()[i] / scalar;
-  }
+  this->ClearNormCache();
+  ev_kernels::Active().divide_(this->Magnitudes(), scalar, this->Magnitudes(),
+                               this->num_dimensions_);
   return *this;
 }
 
 // Operator overload of = to copy assign a new EV from an existing one.
 // The original EV is overwritten with the new properties of the target EV.
-// The pointer to the magnitudes_ array is released and destroyed, and a new
-// unique pointer is created and filled with the magnitudes of the target EV.
+// If the dimensions differ, the storage is reallocated to fit the target EV,
+// and then it is filled with the magnitudes of the target EV.
 EuclideanVector& EuclideanVector::operator=(const EuclideanVector& copy) noexcept {
   if (&copy == this)
     return *this;
   if (num_dimensions_ != copy.num_dimensions_) {
-    magnitudes_.reset();
-    num_dimensions_ = copy.num_dimensions_;
-  }
-  magnitudes_ = std::make_unique<double[]>(num_dimensions_);
-  for (int i = 0; i < this->num_dimensions_; i++) {
-    magnitudes_.get()[i] = copy.magnitudes_.get()[i];
+    this->Allocate(copy.num_dimensions_);
   }
+  std::copy(copy.Magnitudes(), copy.Magnitudes() + num_dimensions_, this->Magnitudes());
+  this->CopyNormCache(copy);
   return *this;
 }
 
 // Operator overload of = to move construct a new EV from an existing one.
 // The target EV has its properties set to an unspecified but valid state, its
-// ownership of the pointer to the magnitudes_ array is transferred to the target,
-// and its num_dimensions_ is set to 0.
+// ownership of a heap array of magnitudes is transferred to the target (inline
+// magnitudes are copied), and its num_dimensions_ is set to 0.
 EuclideanVector& EuclideanVector::operator=(EuclideanVector&& mv) noexcept {
-  magnitudes_ = std::move(mv.magnitudes_);
-  num_dimensions_ = mv.num_dimensions_;
-  mv.num_dimensions_ = 0;
+  this->TakeMagnitudes(mv);
   return *this;
 }
 
-// Operator overload of [] to access a particular [index] of an EVs magnitudes_ array.
-// The function will crash the program if the user attempts to access an element in the magnitudes_
-// array that is out of bounds through the usage of a c-style assert.
-// This function is used to SET the value in the given index.
-double& EuclideanVector::operator[](int index) {
+// Operator overload of [] to access a particular [index] of an EVs magnitudes.
+// The function will crash the program if the user attempts to access an element in the magnitudes
+// that is out of bounds through the usage of a c-style assert.
+// This function is used to SET the value in the given index, through a MagnitudeReference
+// that clears the cached norm when it is written to.
+EuclideanVector::MagnitudeReference EuclideanVector::operator[](int index) {
   assert(index >= 0 && index < this->num_dimensions_);
-  return this->magnitudes_[index];
+  return MagnitudeReference{*this, this->Magnitudes()[index]};
 }
 
-// Operator overload of [] to access a particular [index] of an EVs magnitudes_ array.
-// The function will crash the program if the user attempts to access an element in the magnitudes_
-// array that is out of bounds through the usage of a c-style assert.
+// Operator overload of [] to access a particular [index] of an EVs magnitudes.
+// The function will crash the program if the user attempts to access an element in the magnitudes
+// that is out of bounds through the usage of a c-style assert.
 // This function is used to GET the value in the given index.
 const double& EuclideanVector::operator[](int index) const{
   assert(index >= 0 && index < this->num_dimensions_);
-  return this->magnitudes_[index];
+  return this->Magnitudes()[index];
 }
 
 // This function performs the inverse of the alternate constructor, and returns a
 // std::vector<double> from a given EuclideanVector.
 EuclideanVector::operator std::vector<double>() const noexcept{
-  std::vector<double> to_vector(&this->magnitudes_[0],
-                                &this->magnitudes_[0] + this->num_dimensions_);
+  std::vector<double> to_vector(this->Magnitudes(), this->Magnitudes() + this->num_dimensions_);
   return to_vector;
 }
 
 // This function performs the inverse of the alternate constructor, and returns a
 // std::list<double> from a given EuclideanVector.
 EuclideanVector::operator std::list<double>() const noexcept{
-  std::list<double> to_list(&this->magnitudes_[0], &this->magnitudes_[0] + this->num_dimensions_);
+  std::list<double> to_list(this->Magnitudes(), this->Magnitudes() + this->num_dimensions_);
   return to_list;
 }
+
+/********************* STORAGE *************************************/
+
+// Sets num_dimensions_ and makes room for that many magnitudes, which are left
+// uninitialised. Small vectors use the inline array, so need no heap allocation.
+void EuclideanVector::Allocate(int num_dimensions) noexcept {
+  this->num_dimensions_ = num_dimensions;
+  this->ClearNormCache();
+  if (num_dimensions > kInlineDimensions) {
+    this->heap_magnitudes_.reset(new double[num_dimensions]);
+  } else {
+    this->heap_magnitudes_.reset();
+  }
+}
+
+// Moves the magnitudes (and cached norm) of other into this EV, and leaves other with
+// 0 dimensions
+void EuclideanVector::TakeMagnitudes(EuclideanVector& other) noexcept {
+  if (&other == this) {
+    return;
+  }
+  this->num_dimensions_ = other.num_dimensions_;
+  this->heap_magnitudes_ = std::move(other.heap_magnitudes_);
+  if (!this->heap_magnitudes_) {
+    std::copy(other.inline_magnitudes_, other.inline_magnitudes_ + other.num_dimensions_,
+              this->inline_magnitudes_);
+  }
+  this->CopyNormCache(other);
+  other.num_dimensions_ = 0;
+  other.ClearNormCache();
+}
@@ -22,10 +22,14 @@
 #include <cassert>
 #include <cmath>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <list>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -38,14 +42,64 @@ class EuclideanVectorError : public std::exception {
   std::string what_;
 };
 
+class EuclideanVector;
+template <typename L, typename R, typename Op>
+class BinaryExpression;
+template <typename E, typename Op>
+class ScalarExpression;
+
+// The base of EuclideanVector and of every arithmetic expression over EuclideanVectors.
+// Operators +, - and scalar * and / don't compute anything: they return a small expression
+// object that refers to their operands. Converting the expression to an EuclideanVector
+// evaluates the whole tree in one loop, so a + b - c * 2.0 allocates only its result.
+// Expressions refer to the EuclideanVectors they were built from, so convert them before
+// those vectors go out of scope rather than keeping them in an auto variable.
+template <typename E>
+class VectorExpression {
+ public:
+  const E& Self() const noexcept { return static_cast<const E&>(*this); }
+  // As EuclideanVector::at, but computes only the one element
+  double at(int index) const;
+};
+
 // Creates a new Euclidean Vector as described in the licence above
 // Example:
 //  EuclideanVector a{1,2,3}; Euclidean Vector b{2,4,6};
 //  EuclideanVector c = a + b;
 //  std::cout << c;
 // Outputs -> [3, 6, 9]
-class EuclideanVector {
+class EuclideanVector : public VectorExpression<EuclideanVector> {
  public:
+  // A reference to one magnitude, which is what the non-const operator[] and at return.
+  // It reads like a double&, but writing through it also clears the cached norm. It can't be
+  // copied, so that a named copy can't silently keep writing into the vector.
+  class MagnitudeReference {
+   public:
+    MagnitudeReference(const MagnitudeReference&) = delete;
+    operator double() const noexcept { return magnitude_; }  // NOLINT(runtime/explicit)
+    MagnitudeReference& operator=(double value) noexcept {
+      owner_.ClearNormCache();
+      magnitude_ = value;
+      return *this;
+    }
+    // Assigns the value of other, like assigning one double& to another
+    MagnitudeReference& operator=(const MagnitudeReference& other) noexcept {
+      return *this = static_cast<double>(other);
+    }
+    MagnitudeReference& operator+=(double value) noexcept { return *this = magnitude_ + value; }
+    MagnitudeReference& operator-=(double value) noexcept { return *this = magnitude_ - value; }
+    MagnitudeReference& operator*=(double value) noexcept { return *this = magnitude_ * value; }
+    MagnitudeReference& operator/=(double value) noexcept { return *this = magnitude_ / value; }
+
+   private:
+    friend class EuclideanVector;
+    MagnitudeReference(EuclideanVector& owner, double& magnitude) noexcept
+      : owner_{owner}, magnitude_{magnitude} {}
+
+    EuclideanVector& owner_;
+    double& magnitude_;
+  };
+
   /************** constructors ******************/
   // The default constructor for an EV has 1 dimension and this dimension has a magnitude of 0
   explicit EuclideanVector(int i = 1) : EuclideanVector(i, 0.0) {}
@@ -65,16 +119,14 @@ class EuclideanVector {
 
   // The move constructor of the EV class   
   EuclideanVector(EuclideanVector&&) noexcept;
+
+  // Evaluates an expression such as a + b - c * 2.0, without any temporary vectors
+  template <typename E>
+  EuclideanVector(const VectorExpression<E>&);  // NOLINT(runtime/explicit)
   ~EuclideanVector() = default;
 
   /************** friend overloads ******************/
   friend std::ostream& operator<<(std::ostream& os, const EuclideanVector& v) noexcept;
-  friend EuclideanVector operator+(const EuclideanVector&, const EuclideanVector&);
-  friend double operator*(const EuclideanVector&, const EuclideanVector&);
-  friend EuclideanVector operator*(const EuclideanVector&, const double&) noexcept;
-  friend EuclideanVector operator*(const double&, const EuclideanVector&) noexcept;
-  friend EuclideanVector operator/(const EuclideanVector&, const double&);
-  friend EuclideanVector operator-(const EuclideanVector&, const EuclideanVector&);
   friend bool operator==(const EuclideanVector&, const EuclideanVector&) noexcept;
   friend bool operator!=(const EuclideanVector&, const EuclideanVector&) noexcept;
 
@@ -85,22 +137,147 @@ class EuclideanVector {
   EuclideanVector& operator/=(const double&);
   EuclideanVector& operator=(const EuclideanVector&) noexcept;
   EuclideanVector& operator=(EuclideanVector&&) noexcept;
-  double& operator[](int);
+  template <typename E>
+  EuclideanVector& operator+=(const VectorExpression<E>&);
+  template <typename E>
+  EuclideanVector& operator-=(const VectorExpression<E>&);
+  template <typename E>
+  EuclideanVector& operator=(const VectorExpression<E>&);
+  // The non-const operator[] and at return a MagnitudeReference rather than a double&, so a
+  // magnitude of a non-const vector can't be bound to a double& or have its address taken.
+  // Use a const vector, e.g. &std::as_const(v)[0], for those.
+  MagnitudeReference operator[](int);
   const double& operator[](int) const;
   explicit operator std::vector<double>() const noexcept;
   explicit operator std::list<double>() const noexcept;
 
   /************** methods ******************/
   int GetNumDimensions() const noexcept { return num_dimensions_; }
-  double& at(const int&);
+  MagnitudeReference at(const int&);
   double at(const int&) const;
+  // The norm is cached until the vector is next modified
   double GetEuclideanNorm() const;
   EuclideanVector CreateUnitVector() const;
 
  private:
+  template <typename L, typename R, typename Op>
+  friend class BinaryExpression;
+  template <typename E, typename Op>
+  friend class ScalarExpression;
+
  /************** private members ******************/
+  // Vectors of up to kInlineDimensions dimensions keep their magnitudes in inline_magnitudes_;
+  // only larger ones allocate heap_magnitudes_
+  static constexpr int kInlineDimensions = 4;
+  // The bits of a quiet NaN, which norm_cache_ holds while there is no cached norm
+  static constexpr std::uint64_t kNoNorm = 0x7ff8000000000000;
+
+  void Allocate(int num_dimensions) noexcept;
+  void TakeMagnitudes(EuclideanVector& other) noexcept;
+  void ClearNormCache() noexcept { norm_cache_.store(kNoNorm, std::memory_order_relaxed); }
+  void CopyNormCache(const EuclideanVector& other) noexcept {
+    norm_cache_.store(other.norm_cache_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  double* Magnitudes() noexcept {
+    return heap_magnitudes_ ? heap_magnitudes_.get() : inline_magnitudes_;
+  }
+  const double* Magnitudes() const noexcept {
+    return heap_magnitudes_ ? heap_magnitudes_.get() : inline_magnitudes_;
+  }
+
   int num_dimensions_;
-  std::unique_ptr<double[]> magnitudes_;
+  std::unique_ptr<double[]> heap_magnitudes_;
+  double inline_magnitudes_[kInlineDimensions];
+  // The bits of the norm set by GetEuclideanNorm, cleared by everything that changes a magnitude.
+  // It is atomic so a const EV can be read from several threads at once; threads racing to set
+  // it store the same norm, so relaxed ordering is enough.
+  mutable std::atomic<std::uint64_t> norm_cache_{kNoNorm};
 };
 
+/************** expression templates ******************/
+
+// Nested expressions are small and are held by value; EuclideanVectors are held by reference
+template <typename E>
+using ExpressionOperand =
+    std::conditional_t<std::is_same<E, EuclideanVector>::value, const EuclideanVector&, const E>;
+
+// Whether E keeps its magnitudes in one array, which it returns from Magnitudes(). Expressions
+// over such operands run on the SIMD kernels rather than element by element.
+template <typename E>
+struct HasContiguousMagnitudes : std::false_type {};
+template <>
+struct HasContiguousMagnitudes<EuclideanVector> : std::true_type {};
+
+// lhs Op rhs, element by element, where Op is std::plus<> or std::minus<>
+template <typename L, typename R, typename Op>
+class BinaryExpression : public VectorExpression<BinaryExpression<L, R, Op>> {
+ public:
+  // Throws an EuclideanVectorError if lhs and rhs have different dimensions
+  BinaryExpression(const L& lhs, const R& rhs);
+
+  int GetNumDimensions() const noexcept { return lhs_.GetNumDimensions(); }
+  double operator[](int index) const { return Op{}(lhs_[index], rhs_[index]); }
+  // Writes every element to out, which may be the array of one of the operands
+  void EvaluateInto(double* out) const;
+  // The sum of every element, without storing any of them
+  double Sum() const;
+
+ private:
+  ExpressionOperand<L> lhs_;
+  ExpressionOperand<R> rhs_;
+};
+
+// expression Op scalar, element by element, where Op is std::multiplies<> or std::divides<>
+template <typename E, typename Op>
+class ScalarExpression : public VectorExpression<ScalarExpression<E, Op>> {
+ public:
+  // Throws an EuclideanVectorError when dividing by 0
+  ScalarExpression(const E& expression, double scalar);
+
+  int GetNumDimensions() const noexcept { return expression_.GetNumDimensions(); }
+  double operator[](int index) const { return Op{}(expression_[index], scalar_); }
+  void EvaluateInto(double* out) const;
+
+ private:
+  ExpressionOperand<E> expression_;
+  double scalar_;
+};
+
+template <typename L, typename R>
+BinaryExpression<L, R, std::plus<>> operator+(const VectorExpression<L>&,
+                                              const VectorExpression<R>&);
+template <typename L, typename R>
+BinaryExpression<L, R, std::minus<>> operator-(const VectorExpression<L>&,
+                                               const VectorExpression<R>&);
+template <typename E>
+ScalarExpression<E, std::multiplies<>> operator*(const VectorExpression<E>&,
+                                                 const double&) noexcept;
+template <typename E>
+ScalarExpression<E, std::multiplies<>> operator*(const double&,
+                                                 const VectorExpression<E>&) noexcept;
+template <typename E>
+ScalarExpression<E, std::divides<>> operator/(const VectorExpression<E>&, const double&);
+// The dot product of two expressions
+template <typename L, typename R>
+double operator*(const VectorExpression<L>&, const VectorExpression<R>&);
+
+// When an operand is an expiring EuclideanVector, the result is computed into its magnitudes
+// and returned, rather than evaluated into a new vector. EuclideanVector{a} + b - c * 2.0
+// therefore allocates only for the copy of a.
+template <typename R>
+EuclideanVector operator+(EuclideanVector&&, const VectorExpression<R>&);
+template <typename L>
+EuclideanVector operator+(const VectorExpression<L>&, EuclideanVector&&);
+EuclideanVector operator+(EuclideanVector&&, EuclideanVector&&);
+template <typename R>
+EuclideanVector operator-(EuclideanVector&&, const VectorExpression<R>&);
+template <typename L>
+EuclideanVector operator-(const VectorExpression<L>&, EuclideanVector&&);
+EuclideanVector operator-(EuclideanVector&&, EuclideanVector&&);
+EuclideanVector operator*(EuclideanVector&&, const double&) noexcept;
+EuclideanVector operator*(const double&, EuclideanVector&&) noexcept;
+EuclideanVector operator/(EuclideanVector&&, const double&);
+
+#include "assignments/ev/euclidean_vector.tpp"
+
 #endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_H_
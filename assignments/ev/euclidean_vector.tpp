@@ -0,0 +1,188 @@
+#ifndef ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_T_
+#define ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_T_
+
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+#include "assignments/ev/euclidean_vector_kernels.h"
+
+/********************* EXPRESSIONS *************************************/
+
+template <typename E>
+double VectorExpression<E>::at(int index) const {
+  if (index < 0 || index >= Self().GetNumDimensions()) {
+    std::string error_message =
+        "Index " + std::to_string(index) + " is not valid for this EuclideanVector object";
+    throw EuclideanVectorError(error_message);
+  }
+  return Self()[index];
+}
+
+template <typename L, typename R, typename Op>
+BinaryExpression<L, R, Op>::BinaryExpression(const L& lhs, const R& rhs) : lhs_{lhs}, rhs_{rhs} {
+  if (lhs.GetNumDimensions() != rhs.GetNumDimensions()) {
+    std::string error_message = "Dimensions of LHS(" + std::to_string(lhs.GetNumDimensions()) +
+                                ") and RHS(" + std::to_string(rhs.GetNumDimensions()) +
+                                ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+}
+
+// An expression over two contiguous operands, such as EuclideanVectors, is a single SIMD kernel
+// call. Anything deeper is one fused loop: every element of the tree is computed from the same
+// index of each operand, so out may alias an operand without changing the result.
+template <typename L, typename R, typename Op>
+void BinaryExpression<L, R, Op>::EvaluateInto(double* out) const {
+  constexpr bool kLeaves = HasContiguousMagnitudes<L>::value && HasContiguousMagnitudes<R>::value;
+  if constexpr (kLeaves && std::is_same<Op, std::plus<>>::value) {
+    ev_kernels::Active().add_(lhs_.Magnitudes(), rhs_.Magnitudes(), out,
+                              GetNumDimensions());
+  } else if constexpr (kLeaves && std::is_same<Op, std::minus<>>::value) {
+    ev_kernels::Active().subtract_(lhs_.Magnitudes(), rhs_.Magnitudes(), out,
+                                   GetNumDimensions());
+  } else {
+    for (int i = 0; i < GetNumDimensions(); ++i) {
+      out[i] = (*this)[i];
+    }
+  }
+}
+
+// The sum of two contiguous operands multiplied element by element is the SIMD dot product kernel
+template <typename L, typename R, typename Op>
+double BinaryExpression<L, R, Op>::Sum() const {
+  if constexpr (HasContiguousMagnitudes<L>::value && HasContiguousMagnitudes<R>::value &&
+                std::is_same<Op, std::multiplies<>>::value) {
+    return ev_kernels::Active().dot_(lhs_.Magnitudes(), rhs_.Magnitudes(),
+                                     GetNumDimensions());
+  } else {
+    double sum = 0;
+    for (int i = 0; i < GetNumDimensions(); ++i) {
+      sum += (*this)[i];
+    }
+    return sum;
+  }
+}
+
+template <typename E, typename Op>
+ScalarExpression<E, Op>::ScalarExpression(const E& expression, double scalar)
+    : expression_{expression}, scalar_{scalar} {
+  if (std::is_same<Op, std::divides<>>::value && scalar == 0) {
+    throw EuclideanVectorError("Invalid vector division by 0");
+  }
+}
+
+template <typename E, typename Op>
+void ScalarExpression<E, Op>::EvaluateInto(double* out) const {
+  constexpr bool kLeaf = HasContiguousMagnitudes<E>::value;
+  if constexpr (kLeaf && std::is_same<Op, std::multiplies<>>::value) {
+    ev_kernels::Active().scale_(expression_.Magnitudes(), scalar_, out, GetNumDimensions());
+  } else if constexpr (kLeaf && std::is_same<Op, std::divides<>>::value) {
+    ev_kernels::Active().divide_(expression_.Magnitudes(), scalar_, out, GetNumDimensions());
+  } else {
+    for (int i = 0; i < GetNumDimensions(); ++i) {
+      out[i] = (*this)[i];
+    }
+  }
+}
+
+template <typename L, typename R>
+BinaryExpression<L, R, std::plus<>> operator+(const VectorExpression<L>& lhs,
+                                              const VectorExpression<R>& rhs) {
+  return BinaryExpression<L, R, std::plus<>>(lhs.Self(), rhs.Self());
+}
+
+template <typename L, typename R>
+BinaryExpression<L, R, std::minus<>> operator-(const VectorExpression<L>& lhs,
+                                               const VectorExpression<R>& rhs) {
+  return BinaryExpression<L, R, std::minus<>>(lhs.Self(), rhs.Self());
+}
+
+template <typename E>
+ScalarExpression<E, std::multiplies<>> operator*(const VectorExpression<E>& expression,
+                                                 const double& scalar) noexcept {
+  return ScalarExpression<E, std::multiplies<>>(expression.Self(), scalar);
+}
+
+template <typename E>
+ScalarExpression<E, std::multiplies<>> operator*(const double& scalar,
+                                                 const VectorExpression<E>& expression) noexcept {
+  return ScalarExpression<E, std::multiplies<>>(expression.Self(), scalar);
+}
+
+template <typename E>
+ScalarExpression<E, std::divides<>> operator/(const VectorExpression<E>& expression,
+                                              const double& scalar) {
+  return ScalarExpression<E, std::divides<>>(expression.Self(), scalar);
+}
+
+// Throws an EuclideanVectorError if the dimensions don't match. The result is within the
+// tolerance documented in euclidean_vector_kernels.h of the exact dot product.
+template <typename L, typename R>
+double operator*(const VectorExpression<L>& lhs, const VectorExpression<R>& rhs) {
+  return BinaryExpression<L, R, std::multiplies<>>(lhs.Self(), rhs.Self()).Sum();
+}
+
+// As with the other operators, a vector with no dimensions produces the 1 dimension vector [0]
+template <typename R>
+EuclideanVector operator+(EuclideanVector&& lhs, const VectorExpression<R>& rhs) {
+  lhs += rhs;
+  return lhs.GetNumDimensions() == 0 ? EuclideanVector{} : std::move(lhs);
+}
+
+// rhs is overwritten in place, which is safe as each element only reads the same element of rhs
+template <typename L>
+EuclideanVector operator+(const VectorExpression<L>& lhs, EuclideanVector&& rhs) {
+  rhs = BinaryExpression<L, EuclideanVector, std::plus<>>(lhs.Self(), rhs);
+  return rhs.GetNumDimensions() == 0 ? EuclideanVector{} : std::move(rhs);
+}
+
+template <typename R>
+EuclideanVector operator-(EuclideanVector&& lhs, const VectorExpression<R>& rhs) {
+  lhs -= rhs;
+  return lhs.GetNumDimensions() == 0 ? EuclideanVector{} : std::move(lhs);
+}
+
+template <typename L>
+EuclideanVector operator-(const VectorExpression<L>& lhs, EuclideanVector&& rhs) {
+  rhs = BinaryExpression<L, EuclideanVector, std::minus<>>(lhs.Self(), rhs);
+  return rhs.GetNumDimensions() == 0 ? EuclideanVector{} : std::move(rhs);
+}
+
+/********************* EUCLIDEAN VECTOR *************************************/
+
+// As with the other operators, an expression with no dimensions produces the 1 dimension
+// vector [0]. The magnitudes are left uninitialised as the expression writes every element.
+template <typename E>
+EuclideanVector::EuclideanVector(const VectorExpression<E>& expression) {
+  const E& self = expression.Self();
+  this->Allocate(std::max(self.GetNumDimensions(), 1));
+  this->Magnitudes()[0] = 0.0;
+  self.EvaluateInto(this->Magnitudes());
+}
+
+// Evaluates in place when the dimensions match. Otherwise the expression may still refer to
+// this vector, so the result is built before the old magnitudes are released.
+template <typename E>
+EuclideanVector& EuclideanVector::operator=(const VectorExpression<E>& expression) {
+  const E& self = expression.Self();
+  if (self.GetNumDimensions() == this->num_dimensions_) {
+    this->ClearNormCache();
+    self.EvaluateInto(this->Magnitudes());
+  } else {
+    *this = EuclideanVector{expression};
+  }
+  return *this;
+}
+
+template <typename E>
+EuclideanVector& EuclideanVector::operator+=(const VectorExpression<E>& expression) {
+  return *this = BinaryExpression<EuclideanVector, E, std::plus<>>(*this, expression.Self());
+}
+
+template <typename E>
+EuclideanVector& EuclideanVector::operator-=(const VectorExpression<E>& expression) {
+  return *this = BinaryExpression<EuclideanVector, E, std::minus<>>(*this, expression.Self());
+}
+
+#endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_T_
@@ -0,0 +1,330 @@
+#include "assignments/ev/euclidean_vector_batch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "assignments/ev/euclidean_vector_kernels.h"
+
+namespace {
+
+constexpr std::size_t kAlignment = 64;
+constexpr int kDoublesPerLine = kAlignment / sizeof(double);
+// Fewer magnitudes than this aren't worth starting another thread for
+constexpr std::size_t kMinMagnitudesPerThread = 1 << 16;
+
+// A zeroed, cache line aligned array of count doubles
+double* AllocateMagnitudes(std::size_t count) {
+  std::size_t bytes = std::max<std::size_t>(count * sizeof(double), 1);
+  bytes = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+  auto magnitudes = static_cast<double*>(std::aligned_alloc(kAlignment, bytes));
+  if (magnitudes == nullptr) {
+    throw std::bad_alloc();
+  }
+  std::memset(magnitudes, 0, bytes);
+  return magnitudes;
+}
+
+// Splits [0, count) into one contiguous block per thread and calls body(begin, end) on each
+template <typename Body>
+void ParallelFor(int count, int num_dimensions, unsigned threads, Body body) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::size_t magnitudes = static_cast<std::size_t>(count) * num_dimensions;
+  threads = static_cast<unsigned>(
+      std::min<std::size_t>(threads, magnitudes / kMinMagnitudesPerThread + 1));
+  if (threads <= 1) {
+    body(0, count);
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t) {
+    int begin = static_cast<int>(static_cast<std::size_t>(count) * t / threads);
+    int end = static_cast<int>(static_cast<std::size_t>(count) * (t + 1) / threads);
+    workers.emplace_back(body, begin, end);
+  }
+  body(0, static_cast<int>(count / threads));
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+}  // namespace
+
+/********************* CONSTRUCTORS *************************************/
+
+EuclideanVectorBatch::EuclideanVectorBatch(int num_dimensions, Layout layout)
+    : num_dimensions_{num_dimensions}, layout_{layout}, size_{0}, capacity_{0} {
+  if (num_dimensions < 1) {
+    throw EuclideanVectorError("EuclideanVectorBatch must have at least 1 dimension");
+  }
+  magnitudes_.reset(AllocateMagnitudes(0));
+}
+
+EuclideanVectorBatch::EuclideanVectorBatch(const std::vector<EuclideanVector>& vectors,
+                                           Layout layout)
+    : EuclideanVectorBatch{vectors.empty() ? 0 : vectors.front().GetNumDimensions(), layout} {
+  Reserve(static_cast<int>(vectors.size()));
+  for (const auto& ev : vectors) {
+    PushBack(ev);
+  }
+}
+
+EuclideanVectorBatch::EuclideanVectorBatch(const EuclideanVectorBatch& original)
+    : num_dimensions_{original.num_dimensions_},
+      layout_{original.layout_},
+      size_{original.size_},
+      capacity_{original.capacity_} {
+  std::size_t count = static_cast<std::size_t>(capacity_) * num_dimensions_;
+  magnitudes_.reset(AllocateMagnitudes(count));
+  std::copy(original.magnitudes_.get(), original.magnitudes_.get() + count, magnitudes_.get());
+}
+
+EuclideanVectorBatch::EuclideanVectorBatch(EuclideanVectorBatch&& original) noexcept
+    : num_dimensions_{original.num_dimensions_},
+      layout_{original.layout_},
+      size_{std::exchange(original.size_, 0)},
+      capacity_{std::exchange(original.capacity_, 0)},
+      magnitudes_{std::move(original.magnitudes_)} {
+  original.magnitudes_.reset(AllocateMagnitudes(0));
+}
+
+EuclideanVectorBatch& EuclideanVectorBatch::operator=(const EuclideanVectorBatch& copy) {
+  if (&copy != this) {
+    *this = EuclideanVectorBatch{copy};
+  }
+  return *this;
+}
+
+// original takes this batch's old buffer, which is valid for a capacity of 0, so nothing is
+// allocated
+EuclideanVectorBatch& EuclideanVectorBatch::operator=(EuclideanVectorBatch&& original) noexcept {
+  if (&original != this) {
+    num_dimensions_ = original.num_dimensions_;
+    layout_ = original.layout_;
+    size_ = std::exchange(original.size_, 0);
+    capacity_ = std::exchange(original.capacity_, 0);
+    std::swap(magnitudes_, original.magnitudes_);
+  }
+  return *this;
+}
+
+/********************* METHODS *************************************/
+
+// Rows are copied as a whole. Each dimension of a kStructureOfArrays batch starts at a new
+// offset, so it is copied separately.
+void EuclideanVectorBatch::Reserve(int capacity) {
+  if (layout_ == Layout::kStructureOfArrays) {
+    capacity = (capacity + kDoublesPerLine - 1) / kDoublesPerLine * kDoublesPerLine;
+  }
+  if (capacity <= capacity_) {
+    return;
+  }
+  std::unique_ptr<double[], Free> magnitudes{
+      AllocateMagnitudes(static_cast<std::size_t>(capacity) * num_dimensions_)};
+  if (layout_ == Layout::kRowMajor) {
+    std::copy(magnitudes_.get(), magnitudes_.get() + Offset(size_, 0), magnitudes.get());
+  } else {
+    for (int d = 0; d < num_dimensions_; ++d) {
+      std::copy(magnitudes_.get() + Offset(0, d), magnitudes_.get() + Offset(size_, d),
+                magnitudes.get() + static_cast<std::size_t>(d) * capacity);
+    }
+  }
+  magnitudes_ = std::move(magnitudes);
+  capacity_ = capacity;
+}
+
+void EuclideanVectorBatch::PushBack(const EuclideanVector& ev) {
+  CheckDimensions(ev.GetNumDimensions());
+  if (size_ == capacity_) {
+    Reserve(std::max(kDoublesPerLine, capacity_ * 2));
+  }
+  for (int d = 0; d < num_dimensions_; ++d) {
+    magnitudes_[Offset(size_, d)] = ev[d];
+  }
+  ++size_;
+}
+
+EuclideanVector EuclideanVectorBatch::Get(int index) const {
+  CheckIndex(index);
+  EuclideanVector ev{num_dimensions_};
+  for (int d = 0; d < num_dimensions_; ++d) {
+    ev[d] = magnitudes_[Offset(index, d)];
+  }
+  return ev;
+}
+
+double& EuclideanVectorBatch::at(int index, int dimension) {
+  CheckIndex(index);
+  if (dimension < 0 || dimension >= num_dimensions_) {
+    std::string error_message = "Index " + std::to_string(dimension) +
+                                " is not valid for this EuclideanVector object";
+    throw EuclideanVectorError(error_message);
+  }
+  return magnitudes_[Offset(index, dimension)];
+}
+
+double EuclideanVectorBatch::at(int index, int dimension) const {
+  return const_cast<EuclideanVectorBatch&>(*this).at(index, dimension);
+}
+
+// The kernels take an int length, so rows are grouped into runs of at most INT_MAX magnitudes
+template <typename Span>
+void EuclideanVectorBatch::ForEachSpan(int begin, int end, Span span) const {
+  if (layout_ == Layout::kRowMajor) {
+    int rows = std::max(1, std::numeric_limits<int>::max() / num_dimensions_);
+    for (int first = begin; first < end; first += std::min(rows, end - first)) {
+      span(first, 0, std::min(rows, end - first) * num_dimensions_);
+    }
+    return;
+  }
+  for (int d = 0; d < num_dimensions_; ++d) {
+    span(begin, d, end - begin);
+  }
+}
+
+/********************* BATCHED OPERATIONS *************************************/
+
+// Batches with the same layout are added span by span with the SIMD kernel
+void EuclideanVectorBatch::Add(const EuclideanVectorBatch& other, unsigned threads) {
+  CheckDimensions(other.num_dimensions_);
+  if (size_ != other.size_) {
+    std::string error_message = "Sizes of LHS(" + std::to_string(size_) + ") and RHS(" +
+                                std::to_string(other.size_) + ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+  const auto& kernels = ev_kernels::Active();
+  ParallelFor(size_, num_dimensions_, threads, [&](int begin, int end) {
+    if (layout_ == other.layout_) {
+      ForEachSpan(begin, end, [&](int first, int dimension, int length) {
+        double* magnitudes = magnitudes_.get() + Offset(first, dimension);
+        kernels.add_(magnitudes, other.magnitudes_.get() + other.Offset(first, dimension),
+                     magnitudes, length);
+      });
+      return;
+    }
+    for (int i = begin; i < end; ++i) {
+      for (int d = 0; d < num_dimensions_; ++d) {
+        magnitudes_[Offset(i, d)] += other.magnitudes_[other.Offset(i, d)];
+      }
+    }
+  });
+}
+
+void EuclideanVectorBatch::Scale(double scalar, unsigned threads) {
+  const auto& kernels = ev_kernels::Active();
+  ParallelFor(size_, num_dimensions_, threads, [&](int begin, int end) {
+    ForEachSpan(begin, end, [&](int first, int dimension, int length) {
+      double* magnitudes = magnitudes_.get() + Offset(first, dimension);
+      kernels.scale_(magnitudes, scalar, magnitudes, length);
+    });
+  });
+}
+
+// A row is one dot product kernel call. Across a kStructureOfArrays batch, every dimension is
+// instead a loop over all the vectors, accumulating one product per vector.
+std::vector<double> EuclideanVectorBatch::Dot(const EuclideanVector& query,
+                                              unsigned threads) const {
+  CheckDimensions(query.GetNumDimensions());
+  std::vector<double> dots(size_);
+  const double* q = &query[0];
+  const auto& kernels = ev_kernels::Active();
+  ParallelFor(size_, num_dimensions_, threads, [&](int begin, int end) {
+    if (layout_ == Layout::kRowMajor) {
+      for (int i = begin; i < end; ++i) {
+        dots[i] = kernels.dot_(magnitudes_.get() + Offset(i, 0), q, num_dimensions_);
+      }
+      return;
+    }
+    for (int d = 0; d < num_dimensions_; ++d) {
+      const double* column = magnitudes_.get() + Offset(begin, d);
+      double* out = dots.data() + begin;
+      for (int i = 0; i < end - begin; ++i) {
+        out[i] += q[d] * column[i];
+      }
+    }
+  });
+  return dots;
+}
+
+std::vector<double> EuclideanVectorBatch::GetEuclideanNorms(unsigned threads) const {
+  std::vector<double> norms(size_);
+  const auto& kernels = ev_kernels::Active();
+  ParallelFor(size_, num_dimensions_, threads, [&](int begin, int end) {
+    if (layout_ == Layout::kRowMajor) {
+      for (int i = begin; i < end; ++i) {
+        norms[i] = kernels.sum_of_squares_(magnitudes_.get() + Offset(i, 0), num_dimensions_);
+      }
+    } else {
+      for (int d = 0; d < num_dimensions_; ++d) {
+        const double* column = magnitudes_.get() + Offset(begin, d);
+        double* out = norms.data() + begin;
+        for (int i = 0; i < end - begin; ++i) {
+          out[i] += column[i] * column[i];
+        }
+      }
+    }
+    for (int i = begin; i < end; ++i) {
+      norms[i] = std::sqrt(norms[i]);
+    }
+  });
+  return norms;
+}
+
+// Every norm is checked before any vector is changed
+void EuclideanVectorBatch::Normalize(unsigned threads) {
+  std::vector<double> norms = GetEuclideanNorms(threads);
+  if (std::find(norms.begin(), norms.end(), 0.0) != norms.end()) {
+    throw EuclideanVectorError(
+        "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+  }
+  const auto& kernels = ev_kernels::Active();
+  ParallelFor(size_, num_dimensions_, threads, [&](int begin, int end) {
+    if (layout_ == Layout::kRowMajor) {
+      for (int i = begin; i < end; ++i) {
+        double* row = magnitudes_.get() + Offset(i, 0);
+        kernels.divide_(row, norms[i], row, num_dimensions_);
+      }
+      return;
+    }
+    for (int d = 0; d < num_dimensions_; ++d) {
+      double* column = magnitudes_.get() + Offset(begin, d);
+      const double* divisors = norms.data() + begin;
+      for (int i = 0; i < end - begin; ++i) {
+        column[i] /= divisors[i];
+      }
+    }
+  });
+}
+
+/********************* PRIVATE *************************************/
+
+std::size_t EuclideanVectorBatch::Offset(int index, int dimension) const noexcept {
+  if (layout_ == Layout::kRowMajor) {
+    return static_cast<std::size_t>(index) * num_dimensions_ + dimension;
+  }
+  return static_cast<std::size_t>(dimension) * capacity_ + index;
+}
+
+void EuclideanVectorBatch::CheckIndex(int index) const {
+  if (index < 0 || index >= size_) {
+    std::string error_message =
+        "Index " + std::to_string(index) + " is not valid for this EuclideanVectorBatch object";
+    throw EuclideanVectorError(error_message);
+  }
+}
+
+void EuclideanVectorBatch::CheckDimensions(int num_dimensions) const {
+  if (num_dimensions != num_dimensions_) {
+    std::string error_message = "Dimensions of LHS(" + std::to_string(num_dimensions_) +
+                                ") and RHS(" + std::to_string(num_dimensions) + ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+}
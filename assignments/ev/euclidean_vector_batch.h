@@ -0,0 +1,106 @@
+/*
+* A batch of Euclidean Vectors that all have the same number of dimensions.
+*
+* A std::vector<EuclideanVector> keeps every vector in its own heap block. An
+* EuclideanVectorBatch keeps every magnitude of every vector in one contiguous buffer,
+* aligned to a cache line, and applies each operation to the whole batch at once using the
+* SIMD kernels of euclidean_vector_kernels.h, split across threads for large batches.
+*
+* The magnitudes are laid out in one of two ways:
+*  - kRowMajor stores each vector's magnitudes next to each other, which suits vectors with
+*    many dimensions, as each vector is a single kernel call.
+*  - kStructureOfArrays stores dimension d of every vector next to each other, which suits
+*    vectors with few dimensions, as each loop runs across vectors instead of along them.
+*
+* Every batched operation accepts a number of threads, where 0 picks one thread per core
+* (but never so many that a thread has too little work to be worth starting).
+*/
+
+#ifndef ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_BATCH_H_
+#define ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_BATCH_H_
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "assignments/ev/euclidean_vector.h"
+
+class EuclideanVectorBatch {
+ public:
+  enum class Layout { kRowMajor, kStructureOfArrays };
+
+  /************** constructors ******************/
+  // An empty batch of vectors with num_dimensions dimensions.
+  // Throws an EuclideanVectorError if num_dimensions is less than 1.
+  explicit EuclideanVectorBatch(int num_dimensions, Layout layout = Layout::kRowMajor);
+
+  // A batch holding a copy of every vector in vectors, which must all have the same number of
+  // dimensions. Throws an EuclideanVectorError if they don't, or if vectors is empty.
+  explicit EuclideanVectorBatch(const std::vector<EuclideanVector>& vectors,
+                                Layout layout = Layout::kRowMajor);
+
+  EuclideanVectorBatch(const EuclideanVectorBatch&);
+  // The moves leave original empty, keeping its dimensions and layout, so it can still be used.
+  // The move constructor allocates original a new empty buffer, and terminates the program if
+  // even that fails.
+  EuclideanVectorBatch(EuclideanVectorBatch&& original) noexcept;
+  EuclideanVectorBatch& operator=(const EuclideanVectorBatch&);
+  EuclideanVectorBatch& operator=(EuclideanVectorBatch&& original) noexcept;
+  ~EuclideanVectorBatch() = default;
+
+  /************** methods ******************/
+  int GetNumDimensions() const noexcept { return num_dimensions_; }
+  int GetSize() const noexcept { return size_; }
+  Layout GetLayout() const noexcept { return layout_; }
+
+  // Makes room for capacity vectors, so that pushing that many doesn't reallocate
+  void Reserve(int capacity);
+  // Throws an EuclideanVectorError if ev has a different number of dimensions to the batch
+  void PushBack(const EuclideanVector& ev);
+  // Returns a copy of the vector at index.
+  // Throws an EuclideanVectorError if index is out of bounds.
+  EuclideanVector Get(int index) const;
+  // Returns magnitude dimension of the vector at index.
+  // Throws an EuclideanVectorError if either is out of bounds.
+  double& at(int index, int dimension);
+  double at(int index, int dimension) const;
+
+  /************** batched operations ******************/
+  // Adds every vector of other to the vector at the same index in this batch.
+  // Throws an EuclideanVectorError if the batches differ in size or dimensions.
+  void Add(const EuclideanVectorBatch& other, unsigned threads = 0);
+  // Multiplies every vector by scalar
+  void Scale(double scalar, unsigned threads = 0);
+  // Returns the dot product of every vector with query, within the tolerance documented in
+  // euclidean_vector_kernels.h. Throws an EuclideanVectorError if the dimensions differ.
+  std::vector<double> Dot(const EuclideanVector& query, unsigned threads = 0) const;
+  // Returns the euclidean norm of every vector
+  std::vector<double> GetEuclideanNorms(unsigned threads = 0) const;
+  // Replaces every vector with its unit vector. Throws an EuclideanVectorError, leaving the
+  // batch unchanged, if any vector has a norm of 0.
+  void Normalize(unsigned threads = 0);
+
+ private:
+  struct Free {
+    void operator()(double* magnitudes) const noexcept { std::free(magnitudes); }
+  };
+
+  // The offset of magnitude dimension of the vector at index
+  std::size_t Offset(int index, int dimension) const noexcept;
+  // Calls span(first, dimension, length) for each contiguous run of magnitudes that holds the
+  // vectors in [begin, end), where the run starts at Offset(first, dimension): one run for
+  // kRowMajor, and one for each dimension for kStructureOfArrays
+  template <typename Span>
+  void ForEachSpan(int begin, int end, Span span) const;
+  void CheckIndex(int index) const;
+  void CheckDimensions(int num_dimensions) const;
+
+  int num_dimensions_;
+  Layout layout_;
+  int size_;
+  // kStructureOfArrays rounds capacity_ up, so that every dimension starts on a cache line
+  int capacity_;
+  std::unique_ptr<double[], Free> magnitudes_;
+};
+
+#endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_BATCH_H_
@@ -0,0 +1,206 @@
+#include "assignments/ev/euclidean_vector_dataset.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+constexpr char kMagic[8] = {'E', 'V', 'E', 'C', 'T', 'O', 'R', 'S'};
+constexpr std::uint32_t kVersion = 1;
+
+struct Header {
+  char magic_[8];
+  std::uint32_t version_;
+  std::uint32_t num_dimensions_;
+  std::uint64_t size_;
+  double byte_order_;
+  char padding_[32];
+};
+static_assert(sizeof(Header) == 64, "A dataset header fills one cache line");
+
+Header MakeHeader(int num_dimensions, int size) {
+  Header header{};
+  std::memcpy(header.magic_, kMagic, sizeof(kMagic));
+  header.version_ = kVersion;
+  header.num_dimensions_ = static_cast<std::uint32_t>(num_dimensions);
+  header.size_ = static_cast<std::uint64_t>(size);
+  header.byte_order_ = 1.0;
+  return header;
+}
+
+}  // namespace
+
+/********************* WRITER *************************************/
+
+EuclideanVectorWriter::EuclideanVectorWriter(const std::string& path, int num_dimensions)
+    : path_{path}, num_dimensions_{num_dimensions}, size_{0} {
+  if (num_dimensions < 1) {
+    throw EuclideanVectorError("EuclideanVectorWriter must have at least 1 dimension");
+  }
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  Header header = MakeHeader(num_dimensions_, 0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!file_) {
+    throw EuclideanVectorError("Could not write to " + path);
+  }
+}
+
+EuclideanVectorWriter& EuclideanVectorWriter::operator=(EuclideanVectorWriter&& original) {
+  if (&original != this) {
+    CloseIfOpen();
+    path_ = std::move(original.path_);
+    num_dimensions_ = original.num_dimensions_;
+    size_ = original.size_;
+    file_ = std::move(original.file_);
+  }
+  return *this;
+}
+
+EuclideanVectorWriter::~EuclideanVectorWriter() {
+  CloseIfOpen();
+}
+
+void EuclideanVectorWriter::Write(const EuclideanVector& ev) {
+  WriteMagnitudes(ev.GetNumDimensions() == 0 ? nullptr : &ev[0], ev.GetNumDimensions());
+}
+
+void EuclideanVectorWriter::Write(const EuclideanVectorView& view) {
+  WriteMagnitudes(view.Magnitudes(), view.GetNumDimensions());
+}
+
+// The header was written with a size of 0, so it is rewritten with the final size
+void EuclideanVectorWriter::Close() {
+  if (!file_.is_open()) {
+    throw EuclideanVectorError("Could not write to " + path_ + " as it is closed");
+  }
+  Header header = MakeHeader(num_dimensions_, size_);
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.close();
+  if (!file_) {
+    throw EuclideanVectorError("Could not write to " + path_);
+  }
+}
+
+void EuclideanVectorWriter::CloseIfOpen() noexcept {
+  try {
+    if (file_.is_open()) {
+      Close();
+    }
+  } catch (const EuclideanVectorError&) {
+  }
+}
+
+void EuclideanVectorWriter::WriteMagnitudes(const double* magnitudes, int num_dimensions) {
+  if (num_dimensions != num_dimensions_) {
+    std::string error_message = "Dimensions of LHS(" + std::to_string(num_dimensions_) +
+                                ") and RHS(" + std::to_string(num_dimensions) + ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+  if (!file_.is_open()) {
+    throw EuclideanVectorError("Could not write to " + path_ + " as it is closed");
+  }
+  if (size_ == std::numeric_limits<int>::max()) {
+    throw EuclideanVectorError("Could not write to " + path_ + " as it is full");
+  }
+  file_.write(reinterpret_cast<const char*>(magnitudes),
+              static_cast<std::streamsize>(num_dimensions) * sizeof(double));
+  if (!file_) {
+    throw EuclideanVectorError("Could not write to " + path_);
+  }
+  ++size_;
+}
+
+/********************* DATASET *************************************/
+
+// The whole file is mapped, header included, so the magnitudes keep the alignment they have in
+// the file. The descriptor isn't needed once the mapping exists.
+EuclideanVectorDataset::EuclideanVectorDataset(const std::string& path)
+    : mapping_{nullptr}, mapping_bytes_{0}, magnitudes_{nullptr}, num_dimensions_{0}, size_{0} {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw EuclideanVectorError("Could not read " + path);
+  }
+  struct stat status;
+  if (::fstat(fd, &status) == -1) {
+    ::close(fd);
+    throw EuclideanVectorError("Could not read " + path);
+  }
+  if (static_cast<std::size_t>(status.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw EuclideanVectorError(path + " is not an EuclideanVector dataset");
+  }
+  mapping_bytes_ = static_cast<std::size_t>(status.st_size);
+  mapping_ = ::mmap(nullptr, mapping_bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw EuclideanVectorError("Could not read " + path);
+  }
+
+  Header header;
+  std::memcpy(&header, mapping_, sizeof(header));
+  std::uint64_t magnitudes = header.size_ * header.num_dimensions_;
+  bool valid = std::memcmp(header.magic_, kMagic, sizeof(kMagic)) == 0 &&
+               header.version_ == kVersion && header.byte_order_ == 1.0 &&
+               header.num_dimensions_ >= 1 &&
+               header.num_dimensions_ <= std::numeric_limits<int>::max() &&
+               header.size_ <= std::numeric_limits<int>::max() &&
+               magnitudes == (mapping_bytes_ - sizeof(Header)) / sizeof(double) &&
+               (mapping_bytes_ - sizeof(Header)) % sizeof(double) == 0;
+  if (!valid) {
+    Unmap();
+    throw EuclideanVectorError(path + " is not an EuclideanVector dataset");
+  }
+  num_dimensions_ = static_cast<int>(header.num_dimensions_);
+  size_ = static_cast<int>(header.size_);
+  magnitudes_ = reinterpret_cast<const double*>(static_cast<const char*>(mapping_) +
+                                                sizeof(Header));
+}
+
+EuclideanVectorDataset::EuclideanVectorDataset(EuclideanVectorDataset&& original) noexcept
+    : mapping_{std::exchange(original.mapping_, nullptr)},
+      mapping_bytes_{std::exchange(original.mapping_bytes_, 0)},
+      magnitudes_{std::exchange(original.magnitudes_, nullptr)},
+      num_dimensions_{std::exchange(original.num_dimensions_, 0)},
+      size_{std::exchange(original.size_, 0)} {}
+
+EuclideanVectorDataset& EuclideanVectorDataset::operator=(
+    EuclideanVectorDataset&& original) noexcept {
+  if (&original != this) {
+    Unmap();
+    mapping_ = std::exchange(original.mapping_, nullptr);
+    mapping_bytes_ = std::exchange(original.mapping_bytes_, 0);
+    magnitudes_ = std::exchange(original.magnitudes_, nullptr);
+    num_dimensions_ = std::exchange(original.num_dimensions_, 0);
+    size_ = std::exchange(original.size_, 0);
+  }
+  return *this;
+}
+
+EuclideanVectorDataset::~EuclideanVectorDataset() {
+  Unmap();
+}
+
+EuclideanVectorView EuclideanVectorDataset::at(int index) const {
+  if (index < 0 || index >= size_) {
+    std::string error_message =
+        "Index " + std::to_string(index) + " is not valid for this EuclideanVectorDataset object";
+    throw EuclideanVectorError(error_message);
+  }
+  return (*this)[index];
+}
+
+void EuclideanVectorDataset::Unmap() noexcept {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_bytes_);
+    mapping_ = nullptr;
+  }
+}
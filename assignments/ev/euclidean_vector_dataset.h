@@ -0,0 +1,112 @@
+/*
+* A binary file format for datasets of Euclidean Vectors with the same number of dimensions.
+*
+* Parsing vectors out of text, then copying them into an EuclideanVector, copies every
+* magnitude twice. A dataset file instead holds the raw doubles, in the byte order of the
+* machine that wrote it:
+*  - a 64 byte header: the magic bytes "EVECTORS", a format version, the number of dimensions,
+*    the number of vectors, and the double 1.0, which tells a reader on a machine with a
+*    different byte order to reject the file.
+*  - the magnitudes of every vector, one vector after the other. As the header fills a cache
+*    line, the magnitudes of a mapped file start on one too.
+*
+* An EuclideanVectorWriter streams vectors to a new file one at a time, so a dataset never has
+* to fit in memory. An EuclideanVectorDataset maps a file into memory, read-only, and hands out
+* EuclideanVectorViews of its vectors, which read straight from the mapped pages.
+*/
+
+#ifndef ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_DATASET_H_
+#define ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_DATASET_H_
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+#include "assignments/ev/euclidean_vector.h"
+#include "assignments/ev/euclidean_vector_view.h"
+
+// Example:
+//  {
+//    EuclideanVectorWriter writer{"points.ev", 3};
+//    writer.Write(EuclideanVector{3, 1.0});
+//  }
+//  EuclideanVectorDataset dataset{"points.ev"};
+//  std::cout << dataset[0] * 2.0 + EuclideanVector{3, 1.0};
+// Outputs -> [3 3 3]
+class EuclideanVectorWriter {
+ public:
+  /************** constructors ******************/
+  // Creates, or truncates, the file at path for vectors of num_dimensions dimensions.
+  // Throws an EuclideanVectorError if num_dimensions is less than 1 or path can't be written.
+  EuclideanVectorWriter(const std::string& path, int num_dimensions);
+
+  EuclideanVectorWriter(const EuclideanVectorWriter&) = delete;
+  EuclideanVectorWriter(EuclideanVectorWriter&&) = default;
+  EuclideanVectorWriter& operator=(const EuclideanVectorWriter&) = delete;
+  // Closes the file being written, as the destructor does, before taking over that of original
+  EuclideanVectorWriter& operator=(EuclideanVectorWriter&& original);
+  // Closes the file if Close hasn't been called, ignoring any error
+  ~EuclideanVectorWriter();
+
+  /************** methods ******************/
+  int GetNumDimensions() const noexcept { return num_dimensions_; }
+  // The number of vectors written so far
+  int GetSize() const noexcept { return size_; }
+
+  // Appends ev to the file. Throws an EuclideanVectorError if ev has a different number of
+  // dimensions to the file, or if the write fails.
+  void Write(const EuclideanVector& ev);
+  void Write(const EuclideanVectorView& view);
+  // Records the number of vectors in the header and closes the file, which can't be written to
+  // again. Throws an EuclideanVectorError if the file couldn't be completed.
+  void Close();
+
+ private:
+  void WriteMagnitudes(const double* magnitudes, int num_dimensions);
+  // Closes the file if it is open, ignoring any error
+  void CloseIfOpen() noexcept;
+
+  std::string path_;
+  int num_dimensions_;
+  int size_;
+  std::ofstream file_;
+};
+
+class EuclideanVectorDataset {
+ public:
+  /************** constructors ******************/
+  // Maps the dataset file at path into memory.
+  // Throws an EuclideanVectorError if path can't be read, or isn't a complete dataset file
+  // written on a machine with the same byte order.
+  explicit EuclideanVectorDataset(const std::string& path);
+
+  EuclideanVectorDataset(const EuclideanVectorDataset&) = delete;
+  EuclideanVectorDataset(EuclideanVectorDataset&&) noexcept;
+  EuclideanVectorDataset& operator=(const EuclideanVectorDataset&) = delete;
+  EuclideanVectorDataset& operator=(EuclideanVectorDataset&&) noexcept;
+  // Unmaps the file, after which no view of it may be used
+  ~EuclideanVectorDataset();
+
+  /************** operations ******************/
+  EuclideanVectorView operator[](int index) const noexcept {
+    return EuclideanVectorView{magnitudes_ + static_cast<std::size_t>(index) * num_dimensions_,
+                               num_dimensions_};
+  }
+
+  /************** methods ******************/
+  int GetNumDimensions() const noexcept { return num_dimensions_; }
+  int GetSize() const noexcept { return size_; }
+  // Throws an EuclideanVectorError if index is out of bounds
+  EuclideanVectorView at(int index) const;
+
+ private:
+  void Unmap() noexcept;
+
+  void* mapping_;
+  std::size_t mapping_bytes_;
+  const double* magnitudes_;
+  int num_dimensions_;
+  int size_;
+};
+
+#endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_DATASET_H_
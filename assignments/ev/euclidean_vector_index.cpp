@@ -0,0 +1,382 @@
+#include "assignments/ev/euclidean_vector_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <string>
+#include <thread>
+
+#include "assignments/ev/euclidean_vector_kernels.h"
+
+/********************* CONSTRUCTORS *************************************/
+
+EuclideanVectorIndex::EuclideanVectorIndex(int num_dimensions, Metric metric,
+                                           const Options& options)
+    : num_dimensions_{num_dimensions},
+      metric_{metric},
+      options_{options},
+      level_multiplier_{0},
+      random_{options.seed_},
+      entry_{-1},
+      max_level_{-1} {
+  if (num_dimensions < 1) {
+    throw EuclideanVectorError("EuclideanVectorIndex must have at least 1 dimension");
+  }
+  if (options.max_neighbours_ < 2) {
+    throw EuclideanVectorError("EuclideanVectorIndex must link at least 2 neighbours");
+  }
+  level_multiplier_ = 1 / std::log(static_cast<double>(options.max_neighbours_));
+}
+
+/********************* METHODS *************************************/
+
+int EuclideanVectorIndex::Insert(const EuclideanVector& ev) {
+  int id = Append(ev);
+  std::unique_ptr<VisitedList> visited = TakeVisitedList();
+  Link(id, *visited);
+  ReturnVisitedList(std::move(visited));
+  return id;
+}
+
+// Every vector is stored before any is linked, so the storage never moves under the threads.
+// Each thread then takes the next unlinked vector until none are left, as some take far
+// longer to link than others, reusing one visited list for all of them.
+void EuclideanVectorIndex::Insert(const EuclideanVectorBatch& batch, unsigned threads) {
+  CheckDimensions(batch.GetNumDimensions());
+  if (metric_ == Metric::kCosine) {
+    std::vector<double> norms = batch.GetEuclideanNorms(threads);
+    if (std::find(norms.begin(), norms.end(), 0.0) != norms.end()) {
+      throw EuclideanVectorError(
+          "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+    }
+  }
+  int first = GetSize();
+  for (int i = 0; i < batch.GetSize(); ++i) {
+    Append(batch.Get(i));
+  }
+
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min<unsigned>(threads, static_cast<unsigned>(batch.GetSize()));
+  std::atomic<int> next{first};
+  auto link = [this, &next] {
+    std::unique_ptr<VisitedList> visited = TakeVisitedList();
+    for (int id = next++; id < GetSize(); id = next++) {
+      Link(id, *visited);
+    }
+    ReturnVisitedList(std::move(visited));
+  };
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < threads; ++t) {
+    workers.emplace_back(link);
+  }
+  link();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+EuclideanVector EuclideanVectorIndex::Get(int id) const {
+  if (id < 0 || id >= GetSize()) {
+    std::string error_message =
+        "Index " + std::to_string(id) + " is not valid for this EuclideanVectorIndex object";
+    throw EuclideanVectorError(error_message);
+  }
+  auto begin = magnitudes_.cbegin() + static_cast<std::ptrdiff_t>(id) * num_dimensions_;
+  return EuclideanVector{begin, begin + num_dimensions_};
+}
+
+std::vector<EuclideanVectorIndex::Neighbour> EuclideanVectorIndex::Search(
+    const EuclideanVector& query, int k, int ef) const {
+  CheckDimensions(query.GetNumDimensions());
+  std::vector<double> q = Prepare(query);
+  std::vector<Neighbour> neighbours;
+  int entry;
+  int max_level;
+  {
+    std::lock_guard<std::mutex> lock{entry_lock_};
+    entry = entry_;
+    max_level = max_level_;
+  }
+  if (entry == -1 || k < 1) {
+    return neighbours;
+  }
+
+  Candidate nearest{Distance(q.data(), Magnitudes(entry)), entry};
+  for (int level = max_level; level > 0; --level) {
+    nearest = SearchGreedy(q.data(), nearest, level);
+  }
+  ef = std::max(ef == 0 ? options_.ef_search_ : ef, k);
+  std::unique_ptr<VisitedList> visited = TakeVisitedList();
+  std::vector<Candidate> candidates = SearchLayer(q.data(), nearest, ef, 0, *visited);
+  ReturnVisitedList(std::move(visited));
+  for (int i = 0; i < k && i < static_cast<int>(candidates.size()); ++i) {
+    neighbours.push_back(Neighbour{candidates[i].second, Reported(candidates[i].first)});
+  }
+  return neighbours;
+}
+
+/********************* PRIVATE *************************************/
+
+// A vector reaches each layer above the bottom with probability 1 / max_neighbours_
+int EuclideanVectorIndex::Append(const EuclideanVector& ev) {
+  CheckDimensions(ev.GetNumDimensions());
+  std::vector<double> magnitudes = Prepare(ev);
+  double uniform = std::uniform_real_distribution<double>{0.0, 1.0}(random_);
+  int level = static_cast<int>(-std::log(1.0 - uniform) * level_multiplier_);
+
+  magnitudes_.insert(magnitudes_.end(), magnitudes.begin(), magnitudes.end());
+  bottom_links_.resize(bottom_links_.size() + 1 + MaxLinks(0), 0);
+  upper_links_.emplace_back(static_cast<std::size_t>(level) * (1 + MaxLinks(1)), 0);
+  link_locks_.emplace_back();
+  levels_.push_back(level);
+  return GetSize() - 1;
+}
+
+// A vector that raises the top layer keeps the entry point locked while it links, so that
+// every other insert waits to start from it.
+void EuclideanVectorIndex::Link(int id, VisitedList& visited) {
+  const int level = levels_[id];
+  std::unique_lock<std::mutex> entry_lock{entry_lock_};
+  const int max_level = max_level_;
+  if (entry_ == -1) {
+    entry_ = id;
+    max_level_ = level;
+    return;
+  }
+  Candidate nearest{Distance(Magnitudes(id), Magnitudes(entry_)), entry_};
+  if (level <= max_level) {
+    entry_lock.unlock();
+  }
+
+  const double* q = Magnitudes(id);
+  for (int l = max_level; l > level; --l) {
+    nearest = SearchGreedy(q, nearest, l);
+  }
+  for (int l = std::min(level, max_level); l >= 0; --l) {
+    std::vector<Candidate> candidates =
+        SearchLayer(q, nearest, options_.ef_construction_, l, visited);
+    std::vector<int> neighbours = SelectNeighbours(candidates, MaxLinks(1));
+    SetLinks(id, l, neighbours);
+    for (int neighbour : neighbours) {
+      AddLink(neighbour, id, l);
+    }
+    nearest = candidates.front();
+  }
+
+  if (level > max_level) {
+    entry_ = id;
+    max_level_ = level;
+  }
+}
+
+// The usual HNSW search: candidates holds the vectors left to explore, nearest first, and
+// found the ef nearest seen so far, furthest first. Exploring stops once the nearest candidate
+// is further than every vector found.
+std::vector<EuclideanVectorIndex::Candidate> EuclideanVectorIndex::SearchLayer(
+    const double* query, Candidate entry, int ef, int level, VisitedList& visited) const {
+  visited.Reset(GetSize());
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> candidates;
+  std::priority_queue<Candidate> found;
+  visited.Visit(entry.second);
+  candidates.push(entry);
+  found.push(entry);
+
+  std::vector<int> links;
+  while (!candidates.empty()) {
+    Candidate nearest = candidates.top();
+    if (nearest.first > found.top().first) {
+      break;
+    }
+    candidates.pop();
+    CopyLinks(nearest.second, level, links);
+    for (int neighbour : links) {
+      if (!visited.Visit(neighbour)) {
+        continue;
+      }
+      double distance = Distance(query, Magnitudes(neighbour));
+      if (static_cast<int>(found.size()) < ef || distance < found.top().first) {
+        candidates.emplace(distance, neighbour);
+        found.emplace(distance, neighbour);
+        if (static_cast<int>(found.size()) > ef) {
+          found.pop();
+        }
+      }
+    }
+  }
+
+  std::vector<Candidate> result(found.size());
+  for (auto it = result.rbegin(); it != result.rend(); ++it) {
+    *it = found.top();
+    found.pop();
+  }
+  return result;
+}
+
+std::unique_ptr<EuclideanVectorIndex::VisitedList> EuclideanVectorIndex::TakeVisitedList() const {
+  std::lock_guard<std::mutex> lock{visited_lock_};
+  if (visited_pool_.empty()) {
+    return std::make_unique<VisitedList>();
+  }
+  std::unique_ptr<VisitedList> visited = std::move(visited_pool_.back());
+  visited_pool_.pop_back();
+  return visited;
+}
+
+void EuclideanVectorIndex::ReturnVisitedList(std::unique_ptr<VisitedList> visited) const {
+  std::lock_guard<std::mutex> lock{visited_lock_};
+  visited_pool_.push_back(std::move(visited));
+}
+
+// Grows the list if the index has grown, and starts a new epoch so that every mark from earlier
+// searches is ignored
+void EuclideanVectorIndex::VisitedList::Reset(int size) {
+  if (visited_.size() < static_cast<std::size_t>(size)) {
+    visited_.resize(static_cast<std::size_t>(size), 0);
+  }
+  // Epoch 0 is never used, so that 0 always means unvisited
+  if (++epoch_ == 0) {
+    std::fill(visited_.begin(), visited_.end(), 0);
+    epoch_ = 1;
+  }
+}
+
+bool EuclideanVectorIndex::VisitedList::Visit(int id) noexcept {
+  if (visited_[id] == epoch_) {
+    return false;
+  }
+  visited_[id] = epoch_;
+  return true;
+}
+
+EuclideanVectorIndex::Candidate EuclideanVectorIndex::SearchGreedy(const double* query,
+                                                                   Candidate entry,
+                                                                   int level) const {
+  std::vector<int> links;
+  for (bool moved = true; moved;) {
+    moved = false;
+    CopyLinks(entry.second, level, links);
+    for (int neighbour : links) {
+      double distance = Distance(query, Magnitudes(neighbour));
+      if (distance < entry.first) {
+        entry = Candidate{distance, neighbour};
+        moved = true;
+      }
+    }
+  }
+  return entry;
+}
+
+std::vector<int> EuclideanVectorIndex::SelectNeighbours(const std::vector<Candidate>& candidates,
+                                                        int max_links) const {
+  std::vector<int> selected;
+  for (const auto& candidate : candidates) {
+    if (static_cast<int>(selected.size()) == max_links) {
+      break;
+    }
+    const double* magnitudes = Magnitudes(candidate.second);
+    bool diverse = std::none_of(selected.begin(), selected.end(), [&](int id) {
+      return Distance(magnitudes, Magnitudes(id)) < candidate.first;
+    });
+    if (diverse) {
+      selected.push_back(candidate.second);
+    }
+  }
+  return selected;
+}
+
+void EuclideanVectorIndex::SetLinks(int id, int level, const std::vector<int>& links) {
+  std::lock_guard<std::mutex> lock{link_locks_[id]};
+  int* count = Links(id, level);
+  *count = static_cast<int>(links.size());
+  std::copy(links.begin(), links.end(), count + 1);
+}
+
+// A full vector keeps the most diverse of its links and the new one, chosen as if it were
+// being inserted again
+void EuclideanVectorIndex::AddLink(int id, int neighbour, int level) {
+  std::lock_guard<std::mutex> lock{link_locks_[id]};
+  int* count = Links(id, level);
+  if (*count < MaxLinks(level)) {
+    count[1 + (*count)++] = neighbour;
+    return;
+  }
+  const double* magnitudes = Magnitudes(id);
+  std::vector<Candidate> candidates;
+  candidates.reserve(*count + 1);
+  candidates.emplace_back(Distance(magnitudes, Magnitudes(neighbour)), neighbour);
+  for (int i = 1; i <= *count; ++i) {
+    candidates.emplace_back(Distance(magnitudes, Magnitudes(count[i])), count[i]);
+  }
+  std::sort(candidates.begin(), candidates.end());
+  std::vector<int> links = SelectNeighbours(candidates, MaxLinks(level));
+  *count = static_cast<int>(links.size());
+  std::copy(links.begin(), links.end(), count + 1);
+}
+
+void EuclideanVectorIndex::CopyLinks(int id, int level, std::vector<int>& links) const {
+  std::lock_guard<std::mutex> lock{link_locks_[id]};
+  const int* count = Links(id, level);
+  links.assign(count + 1, count + 1 + *count);
+}
+
+int* EuclideanVectorIndex::Links(int id, int level) noexcept {
+  return const_cast<int*>(static_cast<const EuclideanVectorIndex&>(*this).Links(id, level));
+}
+
+const int* EuclideanVectorIndex::Links(int id, int level) const noexcept {
+  if (level == 0) {
+    return bottom_links_.data() + static_cast<std::size_t>(id) * (1 + MaxLinks(0));
+  }
+  return upper_links_[id].data() + static_cast<std::size_t>(level - 1) * (1 + MaxLinks(level));
+}
+
+int EuclideanVectorIndex::MaxLinks(int level) const noexcept {
+  return level == 0 ? 2 * options_.max_neighbours_ : options_.max_neighbours_;
+}
+
+const double* EuclideanVectorIndex::Magnitudes(int id) const noexcept {
+  return magnitudes_.data() + static_cast<std::size_t>(id) * num_dimensions_;
+}
+
+// L2 compares squared distances, which order the same way without a square root
+double EuclideanVectorIndex::Distance(const double* a, const double* b) const noexcept {
+  const auto& kernels = ev_kernels::Active();
+  switch (metric_) {
+    case Metric::kL2:
+      return kernels.squared_distance_(a, b, num_dimensions_);
+    case Metric::kInnerProduct:
+      return -kernels.dot_(a, b, num_dimensions_);
+    case Metric::kCosine:
+      return 1 - kernels.dot_(a, b, num_dimensions_);
+  }
+  return 0;
+}
+
+double EuclideanVectorIndex::Reported(double distance) const noexcept {
+  return metric_ == Metric::kL2 ? std::sqrt(distance) : distance;
+}
+
+std::vector<double> EuclideanVectorIndex::Prepare(const EuclideanVector& ev) const {
+  auto magnitudes = static_cast<std::vector<double>>(ev);
+  if (metric_ == Metric::kCosine) {
+    double norm = ev.GetEuclideanNorm();
+    if (norm == 0) {
+      throw EuclideanVectorError(
+          "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+    }
+    ev_kernels::Active().divide_(magnitudes.data(), norm, magnitudes.data(), num_dimensions_);
+  }
+  return magnitudes;
+}
+
+void EuclideanVectorIndex::CheckDimensions(int num_dimensions) const {
+  if (num_dimensions != num_dimensions_) {
+    std::string error_message = "Dimensions of LHS(" + std::to_string(num_dimensions_) +
+                                ") and RHS(" + std::to_string(num_dimensions) + ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+}
@@ -0,0 +1,180 @@
+/*
+* An approximate nearest neighbour index over Euclidean Vectors.
+*
+* Comparing a query against every stored vector costs time linear in the number of vectors.
+* An EuclideanVectorIndex links its vectors into a Hierarchical Navigable Small World (HNSW)
+* graph: each vector is linked to a few of its nearest neighbours on the bottom layer, and a
+* random, exponentially shrinking, subset of the vectors is also linked on each layer above.
+* A search walks greedily down from the sparse top layer, then explores the bottom layer
+* around the closest vector found, so it visits roughly a logarithmic number of vectors.
+*
+* The results are approximate. ef, the number of candidates a search keeps, trades speed for
+* recall: a larger ef visits more vectors and misses fewer of the true nearest neighbours.
+*
+* Vectors are identified by the order they were inserted in, starting from 0. Searches may run
+* concurrently with each other, but not with an insert.
+*/
+
+#ifndef ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_INDEX_H_
+#define ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_INDEX_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "assignments/ev/euclidean_vector.h"
+#include "assignments/ev/euclidean_vector_batch.h"
+
+// Example:
+//  EuclideanVectorIndex index{3};
+//  index.Insert(EuclideanVector{3, 1.0});
+//  index.Insert(EuclideanVector{3, 5.0});
+//  std::cout << index.Search(EuclideanVector{3, 4.0}, 1)[0].id_;
+// Outputs -> 1
+class EuclideanVectorIndex {
+ public:
+  // How the distance between two vectors is measured, where a smaller distance is nearer:
+  //  - kL2 is the euclidean norm of their difference.
+  //  - kInnerProduct is the negated dot product.
+  //  - kCosine is 1 minus the cosine of the angle between them. Vectors are stored as their
+  //    unit vectors, so vectors with a norm of 0 can't be inserted or searched for.
+  enum class Metric { kL2, kInnerProduct, kCosine };
+
+  struct Options {
+    // The most links a vector has on each layer above the bottom one, which allows twice as many
+    int max_neighbours_;
+    // The number of candidates kept while finding the neighbours of an inserted vector
+    int ef_construction_;
+    // The number of candidates kept by a search that doesn't give its own
+    int ef_search_;
+    // Seeds the choice of each vector's layers, so that an index can be rebuilt exactly
+    unsigned seed_;
+  };
+  static constexpr Options kDefaultOptions = {16, 200, 64, 0};
+
+  struct Neighbour {
+    int id_;
+    double distance_;
+  };
+
+  /************** constructors ******************/
+  // An empty index of vectors with num_dimensions dimensions.
+  // Throws an EuclideanVectorError if num_dimensions is less than 1, or if
+  // options.max_neighbours_ is less than 2.
+  explicit EuclideanVectorIndex(int num_dimensions, Metric metric = Metric::kL2,
+                                const Options& options = kDefaultOptions);
+
+  // The graph is shared between threads while it is built, so it is neither copied nor moved
+  EuclideanVectorIndex(const EuclideanVectorIndex&) = delete;
+  EuclideanVectorIndex& operator=(const EuclideanVectorIndex&) = delete;
+  ~EuclideanVectorIndex() = default;
+
+  /************** methods ******************/
+  int GetNumDimensions() const noexcept { return num_dimensions_; }
+  int GetSize() const noexcept { return static_cast<int>(levels_.size()); }
+  Metric GetMetric() const noexcept { return metric_; }
+
+  // Adds ev to the index and returns its id.
+  // Throws an EuclideanVectorError if ev has a different number of dimensions to the index.
+  int Insert(const EuclideanVector& ev);
+  // Adds every vector of batch, in order, linking them across threads, where 0 picks one thread
+  // per core. Throws an EuclideanVectorError, leaving the index unchanged, if the dimensions of
+  // batch don't match.
+  void Insert(const EuclideanVectorBatch& batch, unsigned threads = 0);
+  // Returns a copy of the vector with id, which for kCosine is its unit vector.
+  // Throws an EuclideanVectorError if id is out of bounds.
+  EuclideanVector Get(int id) const;
+
+  // Returns the (approximately) k nearest vectors to query, nearest first, keeping ef
+  // candidates, or options.ef_search_ if ef is 0. ef is raised to k if it is smaller.
+  // Returns no vectors if the index is empty or k is less than 1.
+  // Throws an EuclideanVectorError if the dimensions of query don't match.
+  std::vector<Neighbour> Search(const EuclideanVector& query, int k, int ef = 0) const;
+
+ private:
+  // A (distance, id) pair, which orders by distance
+  using Candidate = std::pair<double, int>;
+
+  // The vectors a search has visited. Like gdwg::Graph::AStar, each search marks them with a new
+  // epoch rather than clearing the list, so a search doesn't cost time linear in the index.
+  struct VisitedList {
+    // Starts a new search over size vectors
+    void Reset(int size);
+    // Marks id visited, returning false if it already was
+    bool Visit(int id) noexcept;
+
+    std::uint32_t epoch_ = 0;
+    // id is visited when visited_[id] == epoch_
+    std::vector<std::uint32_t> visited_;
+  };
+
+  // Stores the magnitudes of ev and picks its top layer, without linking it into the graph
+  int Append(const EuclideanVector& ev);
+  // Links the vector with id into the graph. Safe to call for different ids at once, given a
+  // different visited list.
+  void Link(int id, VisitedList& visited);
+  // Returns the up to ef vectors nearest to query on level, found by exploring outwards from
+  // entry, nearest first
+  std::vector<Candidate> SearchLayer(const double* query, Candidate entry, int ef, int level,
+                                     VisitedList& visited) const;
+  // Takes a visited list from the pool, or makes one if every list is in use
+  std::unique_ptr<VisitedList> TakeVisitedList() const;
+  // Returns a list taken by TakeVisitedList to the pool, for the next search to reuse
+  void ReturnVisitedList(std::unique_ptr<VisitedList> visited) const;
+  // Walks from entry to a vector on level that has no nearer neighbour to query
+  Candidate SearchGreedy(const double* query, Candidate entry, int level) const;
+  // Picks up to max_links of the candidates, nearest first, skipping any candidate that is
+  // nearer to an already picked one than to the query, so links spread out in all directions
+  std::vector<int> SelectNeighbours(const std::vector<Candidate>& candidates,
+                                    int max_links) const;
+  // Replaces the links of id on level, under its lock
+  void SetLinks(int id, int level, const std::vector<int>& links);
+  // Adds a link from id to neighbour on level, pruning the links of id if there are too many
+  void AddLink(int id, int neighbour, int level);
+  // Copies the links of id on level, under its lock
+  void CopyLinks(int id, int level, std::vector<int>& links) const;
+  // The links of id on level: a count, followed by room for MaxLinks(level) ids
+  int* Links(int id, int level) noexcept;
+  const int* Links(int id, int level) const noexcept;
+  int MaxLinks(int level) const noexcept;
+  const double* Magnitudes(int id) const noexcept;
+  double Distance(const double* a, const double* b) const noexcept;
+  // Converts a distance used by the graph into the one reported for the metric
+  double Reported(double distance) const noexcept;
+  // The magnitudes to use for ev, which are those of its unit vector for kCosine
+  std::vector<double> Prepare(const EuclideanVector& ev) const;
+  void CheckDimensions(int num_dimensions) const;
+
+  int num_dimensions_;
+  Metric metric_;
+  Options options_;
+  // The layers of the graph shrink by a factor of level_multiplier_ on average
+  double level_multiplier_;
+  std::mt19937 random_;
+
+  // The magnitudes of every vector, one after the other
+  std::vector<double> magnitudes_;
+  // The top layer of each vector
+  std::vector<int> levels_;
+  // The bottom layer links of each vector, at a fixed stride
+  std::vector<int> bottom_links_;
+  // The links of each vector on every layer above the bottom, one after the other
+  std::vector<std::vector<int>> upper_links_;
+  // One lock for the links of each vector. A deque, as std::mutex can't be moved.
+  mutable std::deque<std::mutex> link_locks_;
+
+  // The visited lists not in use, one for each search or linking thread that has finished
+  mutable std::mutex visited_lock_;
+  mutable std::vector<std::unique_ptr<VisitedList>> visited_pool_;
+
+  // Guards the entry point, the vector with the highest top layer
+  mutable std::mutex entry_lock_;
+  int entry_;
+  int max_level_;
+};
+
+#endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_INDEX_H_
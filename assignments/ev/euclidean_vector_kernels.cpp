@@ -0,0 +1,419 @@
+#include "assignments/ev/euclidean_vector_kernels.h"
+
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EV_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ev_kernels {
+namespace {
+
+/********************* SCALAR *************************************/
+
+void AddScalar(const double* a, const double* b, double* out, int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+void SubtractScalar(const double* a, const double* b, double* out, int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = a[i] - b[i];
+  }
+}
+
+void ScaleScalar(const double* a, double scalar, double* out, int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = a[i] * scalar;
+  }
+}
+
+void DivideScalar(const double* a, double scalar, double* out, int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = a[i] / scalar;
+  }
+}
+
+double DotScalar(const double* a, const double* b, int n) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+double SumOfSquaresScalar(const double* a, int n) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += a[i] * a[i];
+  }
+  return sum;
+}
+
+double SquaredDistanceScalar(const double* a, const double* b, int n) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return sum;
+}
+
+#ifdef EV_KERNELS_X86
+// Each SIMD kernel handles whole registers, then finishes the last few elements one at a time
+// (or, on AVX-512, with one masked register).
+
+/********************* SSE2 *************************************/
+
+__attribute__((target("sse2"))) void AddSse2(const double* a, const double* b, double* out,
+                                             int n) {
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+__attribute__((target("sse2"))) void SubtractSse2(const double* a, const double* b, double* out,
+                                                  int n) {
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] - b[i];
+  }
+}
+
+__attribute__((target("sse2"))) void ScaleSse2(const double* a, double scalar, double* out,
+                                               int n) {
+  const __m128d s = _mm_set1_pd(scalar);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), s));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] * scalar;
+  }
+}
+
+__attribute__((target("sse2"))) void DivideSse2(const double* a, double scalar, double* out,
+                                                int n) {
+  const __m128d s = _mm_set1_pd(scalar);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_div_pd(_mm_loadu_pd(a + i), s));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] / scalar;
+  }
+}
+
+__attribute__((target("sse2"))) double Sum(__m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+// Two accumulators hide the latency of the adds
+__attribute__((target("sse2"))) double DotSse2(const double* a, const double* b, int n) {
+  __m128d sum0 = _mm_setzero_pd();
+  __m128d sum1 = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+  }
+  double sum = Sum(_mm_add_pd(sum0, sum1));
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+__attribute__((target("sse2"))) double SumOfSquaresSse2(const double* a, int n) {
+  return DotSse2(a, a, n);
+}
+
+__attribute__((target("sse2"))) double SquaredDistanceSse2(const double* a, const double* b,
+                                                           int n) {
+  __m128d sum0 = _mm_setzero_pd();
+  __m128d sum1 = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128d d0 = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+    const __m128d d1 = _mm_sub_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2));
+    sum0 = _mm_add_pd(sum0, _mm_mul_pd(d0, d0));
+    sum1 = _mm_add_pd(sum1, _mm_mul_pd(d1, d1));
+  }
+  double sum = Sum(_mm_add_pd(sum0, sum1));
+  for (; i < n; ++i) {
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return sum;
+}
+
+/********************* AVX2 *************************************/
+
+__attribute__((target("avx2,fma"))) void AddAvx2(const double* a, const double* b, double* out,
+                                                 int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+__attribute__((target("avx2,fma"))) void SubtractAvx2(const double* a, const double* b,
+                                                      double* out, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] - b[i];
+  }
+}
+
+__attribute__((target("avx2,fma"))) void ScaleAvx2(const double* a, double scalar, double* out,
+                                                   int n) {
+  const __m256d s = _mm256_set1_pd(scalar);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), s));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] * scalar;
+  }
+}
+
+__attribute__((target("avx2,fma"))) void DivideAvx2(const double* a, double scalar, double* out,
+                                                    int n) {
+  const __m256d s = _mm256_set1_pd(scalar);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(a + i), s));
+  }
+  for (; i < n; ++i) {
+    out[i] = a[i] / scalar;
+  }
+}
+
+__attribute__((target("avx2,fma"))) double DotAvx2(const double* a, const double* b, int n) {
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), sum0);
+    sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), sum1);
+  }
+  for (; i + 4 <= n; i += 4) {
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), sum0);
+  }
+  const __m256d total = _mm256_add_pd(sum0, sum1);
+  const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(total), _mm256_extractf128_pd(total, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2,fma"))) double SumOfSquaresAvx2(const double* a, int n) {
+  return DotAvx2(a, a, n);
+}
+
+__attribute__((target("avx2,fma"))) double SquaredDistanceAvx2(const double* a, const double* b,
+                                                               int n) {
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+    const __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+    sum0 = _mm256_fmadd_pd(d0, d0, sum0);
+    sum1 = _mm256_fmadd_pd(d1, d1, sum1);
+  }
+  for (; i + 4 <= n; i += 4) {
+    const __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+    sum0 = _mm256_fmadd_pd(d0, d0, sum0);
+  }
+  const __m256d total = _mm256_add_pd(sum0, sum1);
+  const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(total), _mm256_extractf128_pd(total, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  for (; i < n; ++i) {
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return sum;
+}
+
+/********************* AVX-512 *************************************/
+
+// A mask of the first n % 8 lanes
+__attribute__((target("avx512f"))) __mmask8 TailMask(int n) {
+  return static_cast<__mmask8>((1u << (n % 8)) - 1);
+}
+
+__attribute__((target("avx512f"))) void AddAvx512(const double* a, const double* b, double* out,
+                                                  int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(out + i, _mm512_add_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+  }
+  const __mmask8 tail = TailMask(n);
+  _mm512_mask_storeu_pd(
+      out + i, tail,
+      _mm512_add_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i)));
+}
+
+__attribute__((target("avx512f"))) void SubtractAvx512(const double* a, const double* b,
+                                                       double* out, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(out + i, _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+  }
+  const __mmask8 tail = TailMask(n);
+  _mm512_mask_storeu_pd(
+      out + i, tail,
+      _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i)));
+}
+
+__attribute__((target("avx512f"))) void ScaleAvx512(const double* a, double scalar, double* out,
+                                                    int n) {
+  const __m512d s = _mm512_set1_pd(scalar);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_loadu_pd(a + i), s));
+  }
+  const __mmask8 tail = TailMask(n);
+  _mm512_mask_storeu_pd(out + i, tail, _mm512_mul_pd(_mm512_maskz_loadu_pd(tail, a + i), s));
+}
+
+// The masked-off lanes divide 0 by scalar, which is harmless as they are never stored
+__attribute__((target("avx512f"))) void DivideAvx512(const double* a, double scalar, double* out,
+                                                     int n) {
+  const __m512d s = _mm512_set1_pd(scalar);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(out + i, _mm512_div_pd(_mm512_loadu_pd(a + i), s));
+  }
+  const __mmask8 tail = TailMask(n);
+  _mm512_mask_storeu_pd(out + i, tail, _mm512_div_pd(_mm512_maskz_loadu_pd(tail, a + i), s));
+}
+
+__attribute__((target("avx512f"))) double DotAvx512(const double* a, const double* b, int n) {
+  __m512d sum0 = _mm512_setzero_pd();
+  __m512d sum1 = _mm512_setzero_pd();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), sum0);
+    sum1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), sum1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), sum0);
+  }
+  const __mmask8 tail = TailMask(n);
+  sum1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i),
+                         sum1);
+  // _mm512_reduce_add_pd trips -Wuninitialized inside GCC's own header, so reduce by hand
+  double lanes[8];
+  _mm512_storeu_pd(lanes, _mm512_add_pd(sum0, sum1));
+  return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) +
+         ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+__attribute__((target("avx512f"))) double SumOfSquaresAvx512(const double* a, int n) {
+  return DotAvx512(a, a, n);
+}
+
+__attribute__((target("avx512f"))) double SquaredDistanceAvx512(const double* a,
+                                                                const double* b, int n) {
+  __m512d sum0 = _mm512_setzero_pd();
+  __m512d sum1 = _mm512_setzero_pd();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+    const __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+    sum0 = _mm512_fmadd_pd(d0, d0, sum0);
+    sum1 = _mm512_fmadd_pd(d1, d1, sum1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    const __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+    sum0 = _mm512_fmadd_pd(d0, d0, sum0);
+  }
+  const __mmask8 tail = TailMask(n);
+  const __m512d d1 =
+      _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i));
+  sum1 = _mm512_fmadd_pd(d1, d1, sum1);
+  double lanes[8];
+  _mm512_storeu_pd(lanes, _mm512_add_pd(sum0, sum1));
+  return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) +
+         ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+#endif  // EV_KERNELS_X86
+
+constexpr Kernels kScalar = {Isa::kScalar, AddScalar, SubtractScalar, ScaleScalar, DivideScalar,
+                             DotScalar, SumOfSquaresScalar, SquaredDistanceScalar};
+#ifdef EV_KERNELS_X86
+constexpr Kernels kSse2 = {Isa::kSse2, AddSse2, SubtractSse2, ScaleSse2, DivideSse2,
+                           DotSse2, SumOfSquaresSse2, SquaredDistanceSse2};
+constexpr Kernels kAvx2 = {Isa::kAvx2, AddAvx2, SubtractAvx2, ScaleAvx2, DivideAvx2,
+                           DotAvx2, SumOfSquaresAvx2, SquaredDistanceAvx2};
+constexpr Kernels kAvx512 = {Isa::kAvx512, AddAvx512, SubtractAvx512, ScaleAvx512, DivideAvx512,
+                             DotAvx512, SumOfSquaresAvx512, SquaredDistanceAvx512};
+#endif
+
+}  // namespace
+
+// __builtin_cpu_supports also checks that the operating system saves the wider registers.
+bool IsSupported(Isa isa) noexcept {
+  switch (isa) {
+    case Isa::kScalar:
+      return true;
+#ifdef EV_KERNELS_X86
+    case Isa::kSse2:
+      return __builtin_cpu_supports("sse2");
+    case Isa::kAvx2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case Isa::kAvx512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+const Kernels* For(Isa isa) noexcept {
+  if (!IsSupported(isa)) {
+    return nullptr;
+  }
+  switch (isa) {
+#ifdef EV_KERNELS_X86
+    case Isa::kSse2:
+      return &kSse2;
+    case Isa::kAvx2:
+      return &kAvx2;
+    case Isa::kAvx512:
+      return &kAvx512;
+#endif
+    default:
+      return &kScalar;
+  }
+}
+
+const Kernels& Active() noexcept {
+  static const Kernels& active = [] () -> const Kernels& {
+    for (auto isa : {Isa::kAvx512, Isa::kAvx2, Isa::kSse2}) {
+      if (const Kernels* kernels = For(isa)) {
+        return *kernels;
+      }
+    }
+    return kScalar;
+  }();
+  return active;
+}
+
+}  // namespace ev_kernels
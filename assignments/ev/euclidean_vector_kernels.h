@@ -0,0 +1,54 @@
+/*
+* The loops behind EuclideanVector's arithmetic, over contiguous arrays of doubles.
+*
+* Each kernel is written once as plain scalar code and once for each x86 SIMD extension:
+* SSE2, AVX2 (with FMA) and AVX-512. The widest set that the running CPU supports is picked,
+* once, the first time Active() is called, so one binary runs everywhere.
+*
+* The element by element kernels give exactly the scalar results, as every lane performs the
+* same IEEE operation. Dot, SumOfSquares and SquaredDistance keep one partial sum per lane, and
+* AVX2 and AVX-512 use fused multiply-adds, so they round differently to the scalar sum. For n
+* elements, each result is within n * kTolerance * (the sum of |a[i] * b[i]|) of the exact dot
+* product, and likewise for the others.
+*/
+
+#ifndef ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_KERNELS_H_
+#define ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_KERNELS_H_
+
+#include <limits>
+
+namespace ev_kernels {
+
+constexpr double kTolerance = std::numeric_limits<double>::epsilon();
+
+enum class Isa { kScalar, kSse2, kAvx2, kAvx512 };
+
+// One implementation of every kernel. out may be the same array as a, but must not otherwise
+// overlap a or b.
+struct Kernels {
+  Isa isa_;
+  // out[i] = a[i] + b[i]
+  void (*add_)(const double* a, const double* b, double* out, int n);
+  // out[i] = a[i] - b[i]
+  void (*subtract_)(const double* a, const double* b, double* out, int n);
+  // out[i] = a[i] * scalar
+  void (*scale_)(const double* a, double scalar, double* out, int n);
+  // out[i] = a[i] / scalar
+  void (*divide_)(const double* a, double scalar, double* out, int n);
+  // The sum of a[i] * b[i]
+  double (*dot_)(const double* a, const double* b, int n);
+  // The sum of a[i] * a[i]
+  double (*sum_of_squares_)(const double* a, int n);
+  // The sum of (a[i] - b[i]) * (a[i] - b[i])
+  double (*squared_distance_)(const double* a, const double* b, int n);
+};
+
+bool IsSupported(Isa) noexcept;
+// Returns the kernels for isa, or nullptr if this CPU (or build) doesn't support it
+const Kernels* For(Isa) noexcept;
+// Returns the kernels for the widest instruction set this CPU supports
+const Kernels& Active() noexcept;
+
+}  // namespace ev_kernels
+
+#endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_KERNELS_H_
@@ -19,7 +19,19 @@
 
 */
 
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
 #include "assignments/ev/euclidean_vector.h"
+#include "assignments/ev/euclidean_vector_batch.h"
+#include "assignments/ev/euclidean_vector_dataset.h"
+#include "assignments/ev/euclidean_vector_index.h"
+#include "assignments/ev/euclidean_vector_kernels.h"
+#include "assignments/ev/euclidean_vector_view.h"
+#include "assignments/ev/fixed_euclidean_vector.h"
+#include "assignments/ev/sparse_euclidean_vector.h"
 #include "catch.h"
 
 /**************** CONSTRUCTOR TESTING *********************/
@@ -542,4 +554,638 @@ TEST_CASE("Testing subscript operator[]", "[operator=]") {
   double d {a[0]};
   REQUIRE(d == 7.0);
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("Testing SIMD kernels against the scalar kernels", "[kernels]") {
+  const ev_kernels::Kernels* scalar = ev_kernels::For(ev_kernels::Isa::kScalar);
+  REQUIRE(scalar != nullptr);
+  REQUIRE(ev_kernels::IsSupported(ev_kernels::Active().isa_));
+
+  for (auto isa : {ev_kernels::Isa::kSse2, ev_kernels::Isa::kAvx2, ev_kernels::Isa::kAvx512}) {
+    const ev_kernels::Kernels* simd = ev_kernels::For(isa);
+    REQUIRE((simd == nullptr) == !ev_kernels::IsSupported(isa));
+    if (simd == nullptr) {
+      continue;
+    }
+    // sizes either side of every register width, and one long enough to use every accumulator
+    for (int n : {0, 1, 3, 7, 9, 17, 768, 4099}) {
+      std::vector<double> a(n);
+      std::vector<double> b(n);
+      for (int i = 0; i < n; ++i) {
+        a[i] = std::sin(i + 1.0) * 100;
+        b[i] = std::cos(i * 0.5) / 3;
+      }
+      std::vector<double> expected(n + 1, -1.0);
+      std::vector<double> actual(n + 1, -1.0);
+
+      scalar->add_(a.data(), b.data(), expected.data(), n);
+      simd->add_(a.data(), b.data(), actual.data(), n);
+      REQUIRE(actual == expected);
+      scalar->subtract_(a.data(), b.data(), expected.data(), n);
+      simd->subtract_(a.data(), b.data(), actual.data(), n);
+      REQUIRE(actual == expected);
+      scalar->scale_(a.data(), -2.5, expected.data(), n);
+      simd->scale_(a.data(), -2.5, actual.data(), n);
+      REQUIRE(actual == expected);
+      scalar->divide_(a.data(), 7.0, expected.data(), n);
+      simd->divide_(a.data(), 7.0, actual.data(), n);
+      REQUIRE(actual == expected);
+      // the element past the end is never written
+      REQUIRE(actual[n] == -1.0);
+
+      double magnitude = 0;
+      double squares = 0;
+      double distance = 0;
+      for (int i = 0; i < n; ++i) {
+        magnitude += std::abs(a[i] * b[i]);
+        squares += a[i] * a[i];
+        distance += (a[i] - b[i]) * (a[i] - b[i]);
+      }
+      // both results are within the documented tolerance of the exact value
+      REQUIRE(std::abs(simd->dot_(a.data(), b.data(), n) - scalar->dot_(a.data(), b.data(), n)) <=
+              2 * n * ev_kernels::kTolerance * magnitude);
+      REQUIRE(std::abs(simd->sum_of_squares_(a.data(), n) - scalar->sum_of_squares_(a.data(), n)) <=
+              2 * n * ev_kernels::kTolerance * squares);
+      REQUIRE(std::abs(simd->squared_distance_(a.data(), b.data(), n) -
+                       scalar->squared_distance_(a.data(), b.data(), n)) <=
+              2 * n * ev_kernels::kTolerance * distance);
+    }
+  }
+
+  std::vector<double> v(1000, 0.5);
+  EuclideanVector a{v.begin(), v.end()};
+  REQUIRE(a * a == 250.0);
+  REQUIRE(a.GetEuclideanNorm() == std::sqrt(250.0));
+  REQUIRE((a + a) == EuclideanVector(1000, 1.0));
+  REQUIRE((a - a) == EuclideanVector(1000, 0.0));
+  REQUIRE((a / 0.25) == EuclideanVector(1000, 2.0));
+}
+
+TEST_CASE("Testing expression templates", "[expressions]") {
+  std::vector<double> v1{1.0, 2.0, 3.0};
+  std::vector<double> v2{-4.0, 0.5, 8.0};
+  std::vector<double> v3{2.0, 2.0, -1.0};
+
+  EuclideanVector a{v1.begin(), v1.end()};
+  EuclideanVector b{v2.begin(), v2.end()};
+  EuclideanVector c{v3.begin(), v3.end()};
+  EuclideanVector d{5};
+
+  // a fused expression gives the same result as evaluating one operator at a time
+  EuclideanVector sum = a + b;
+  EuclideanVector scaled = c * 2.0;
+  EuclideanVector step = sum - scaled;
+  EuclideanVector fused = a + b - c * 2.0;
+  REQUIRE(fused == step);
+  REQUIRE(fused.GetNumDimensions() == 3);
+  REQUIRE(fused.at(0) == 1.0 - 4.0 - 4.0);
+
+  EuclideanVector nested{(a - b) / 2.0 + 3.0 * (b + c) - a};
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(nested.at(i) == (v1[i] - v2[i]) / 2.0 + 3.0 * (v2[i] + v3[i]) - v1[i]);
+  }
+
+  // dot products of expressions
+  REQUIRE((a + b) * c == sum * c);
+  REQUIRE(a * (b - c) == a * b - a * c);
+
+  // a vector may appear on both sides of an assignment
+  EuclideanVector e{a};
+  e = b + e * 2.0;
+  REQUIRE(e == b + a * 2.0);
+  e += e - a;
+  REQUIRE(e.at(2) == 2 * (v2[2] + v1[2] * 2.0) - v1[2]);
+  d = a + b;
+  REQUIRE(d == sum);
+
+  // errors are thrown where the expression is built
+  REQUIRE_THROWS_WITH(a + b - EuclideanVector{2}, "Dimensions of LHS(3) and RHS(2) do not match");
+  REQUIRE_THROWS_WITH((a + b) * EuclideanVector{4}, "Dimensions of LHS(3) and RHS(4) do not match");
+  REQUIRE_THROWS_WITH((a - c) / 0, "Invalid vector division by 0");
+  REQUIRE_THROWS_WITH(e += a + EuclideanVector{1}, "Dimensions of LHS(3) and RHS(1) do not match");
+  REQUIRE(e.at(2) == 2 * (v2[2] + v1[2] * 2.0) - v1[2]);
+}
+
+TEST_CASE("Testing inline and heap storage", "[storage]") {
+  // 4 dimensions are stored inline, 5 on the heap; both must copy, move and convert alike
+  for (int dimensions : {1, 4, 5, 9}) {
+    std::vector<double> v(dimensions);
+    for (int i = 0; i < dimensions; ++i) {
+      v[i] = i * 1.5 - 2.0;
+    }
+    EuclideanVector a{v.begin(), v.end()};
+
+    EuclideanVector copy{a};
+    REQUIRE(copy == a);
+    copy[0] = 100.0;
+    REQUIRE(a.at(0) == v[0]);
+
+    EuclideanVector moved{std::move(copy)};
+    REQUIRE(copy.GetNumDimensions() == 0);
+    REQUIRE(moved.GetNumDimensions() == dimensions);
+    REQUIRE(moved.at(0) == 100.0);
+
+    // assignment between every combination of inline and heap sizes
+    for (int other : {2, 4, 5, 12}) {
+      EuclideanVector target{other, 7.0};
+      target = a;
+      REQUIRE(target == a);
+      EuclideanVector from{other, 7.0};
+      from = std::move(target);
+      REQUIRE(from == a);
+      REQUIRE(target.GetNumDimensions() == 0);
+      target = from;
+      REQUIRE(target == a);
+    }
+
+    REQUIRE(std::vector<double>{a} == v);
+    REQUIRE(std::list<double>{a} == std::list<double>(v.begin(), v.end()));
+    REQUIRE((a + a * 2.0) == a * 3.0);
+  }
+}
+
+TEST_CASE("Testing FixedEuclideanVector", "[fixed]") {
+  using Vector3 = FixedEuclideanVector<3>;
+  using IntVector2 = FixedEuclideanVector<2, int>;
+
+  // every operation but the norm is evaluated at compile time
+  constexpr Vector3 a{1, 2, 3};
+  constexpr Vector3 b = a * 2.0 - Vector3{0.5, 0.5, 0.5};
+  static_assert(b == Vector3{1.5, 3.5, 5.5}, "compile time arithmetic");
+  static_assert(a * a == 14, "compile time dot product");
+  static_assert((Vector3::Filled(4.0) / 2.0).GetSquaredNorm() == 12, "compile time division");
+  static_assert(Vector3::GetNumDimensions() == 3, "dimensions are part of the type");
+  static_assert(Vector3{}[2] == 0, "default magnitudes are 0");
+  static_assert(IntVector2{3, 4}.at(1) == 4, "compile time at");
+  static_assert(sizeof(Vector3) == 3 * sizeof(double), "no runtime dimensions");
+  static_assert(!std::is_convertible<FixedEuclideanVector<2>, Vector3>::value,
+                "dimensions are checked at compile time");
+
+  Vector3 c{a};
+  c += b;
+  c -= a;
+  c *= 2;
+  c /= 4;
+  REQUIRE(c == b / 2.0);
+  REQUIRE(c != a);
+  REQUIRE(IntVector2{3, 4}.GetEuclideanNorm() == 5.0);
+  REQUIRE(IntVector2{3, 4}.CreateUnitVector() == FixedEuclideanVector<2>{0.6, 0.8});
+  REQUIRE_THROWS_WITH(a / 0, "Invalid vector division by 0");
+  REQUIRE_THROWS_WITH(a.at(3), "Index 3 is not valid for this EuclideanVector object");
+  REQUIRE_THROWS_WITH(Vector3{}.CreateUnitVector(),
+                      "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+
+  // conversions to and from the dynamic EuclideanVector
+  EuclideanVector dynamic{a};
+  REQUIRE(dynamic.GetNumDimensions() == 3);
+  REQUIRE(dynamic.at(2) == 3.0);
+  REQUIRE(Vector3{dynamic + dynamic} == a * 2.0);
+  REQUIRE(std::vector<double>{dynamic} == std::vector<double>{a});
+  REQUIRE_THROWS_WITH(Vector3{EuclideanVector{2}}, "Dimensions of LHS(3) and RHS(2) do not match");
+
+  std::stringstream out;
+  out << a << EuclideanVector{a};
+  REQUIRE(out.str() == "[1 2 3][1 2 3]");
+}
+
+TEST_CASE("Testing EuclideanVectorBatch", "[batch]") {
+  using Layout = EuclideanVectorBatch::Layout;
+  // enough vectors that the batched operations split across threads
+  constexpr int kSize = 40000;
+  constexpr int kDimensions = 3;
+  std::vector<EuclideanVector> vectors;
+  for (int i = 0; i < kSize; ++i) {
+    std::vector<double> v{i * 0.25, 1.0 - i, std::sin(i)};
+    vectors.emplace_back(v.begin(), v.end());
+  }
+  std::vector<double> q{0.5, -2.0, 3.0};
+  EuclideanVector query{q.begin(), q.end()};
+
+  for (auto layout : {Layout::kRowMajor, Layout::kStructureOfArrays}) {
+    EuclideanVectorBatch batch{vectors, layout};
+    REQUIRE(batch.GetSize() == kSize);
+    REQUIRE(batch.GetNumDimensions() == kDimensions);
+    REQUIRE(batch.Get(7) == vectors[7]);
+    REQUIRE(batch.at(kSize - 1, 2) == vectors.back().at(2));
+
+    std::vector<double> dots = batch.Dot(query, 4);
+    std::vector<double> norms = batch.GetEuclideanNorms(4);
+    for (int i = 0; i < kSize; i += 997) {
+      REQUIRE(std::abs(dots[i] - vectors[i] * query) <= 1e-9 * (1 + std::abs(dots[i])));
+      REQUIRE(std::abs(norms[i] - vectors[i].GetEuclideanNorm()) <= 1e-12 * (1 + norms[i]));
+    }
+    // one thread gives the same results as many
+    REQUIRE(batch.Dot(query, 1) == dots);
+
+    EuclideanVectorBatch other{vectors, Layout::kStructureOfArrays};
+    batch.Add(other, 3);
+    batch.Scale(0.5);
+    REQUIRE(batch.Get(12345) == (vectors[12345] + vectors[12345]) * 0.5);
+
+    batch.Normalize();
+    for (int i = 0; i < kSize; i += 997) {
+      REQUIRE(std::abs(batch.Get(i).GetEuclideanNorm() - 1.0) <= 1e-12);
+    }
+
+    // copies are independent, and pushing more vectors keeps what is already stored
+    EuclideanVectorBatch copy{batch};
+    copy.at(0, 0) = 42.0;
+    REQUIRE(batch.at(0, 0) != 42.0);
+    copy.PushBack(query);
+    REQUIRE(copy.GetSize() == kSize + 1);
+    REQUIRE(copy.Get(kSize) == query);
+    REQUIRE(copy.Get(kSize - 1) == batch.Get(kSize - 1));
+
+    REQUIRE_THROWS_WITH(batch.Dot(EuclideanVector{2}),
+                        "Dimensions of LHS(3) and RHS(2) do not match");
+    REQUIRE_THROWS_WITH(batch.Add(copy), "Sizes of LHS(40000) and RHS(40001) do not match");
+    REQUIRE_THROWS_WITH(batch.Get(kSize),
+                        "Index 40000 is not valid for this EuclideanVectorBatch object");
+    REQUIRE_THROWS_WITH(batch.at(0, 3), "Index 3 is not valid for this EuclideanVector object");
+
+    // a moved-from batch is empty, but can still be copied and pushed to
+    EuclideanVectorBatch moved{std::move(copy)};
+    REQUIRE(moved.GetSize() == kSize + 1);
+    REQUIRE(moved.Get(kSize) == query);
+    REQUIRE(copy.GetSize() == 0);
+    REQUIRE(EuclideanVectorBatch{copy}.GetSize() == 0);
+    REQUIRE_THROWS_WITH(copy.at(0, 0),
+                        "Index 0 is not valid for this EuclideanVectorBatch object");
+    copy.PushBack(query);
+    REQUIRE(copy.Get(0) == query);
+    copy = std::move(moved);
+    REQUIRE(copy.GetSize() == kSize + 1);
+    REQUIRE(moved.GetSize() == 0);
+    moved.PushBack(query);
+    REQUIRE(moved.Get(0) == query);
+  }
+
+  // the first vector is made all 0, so the batch can't be normalised and is left as it was
+  EuclideanVectorBatch zero{vectors};
+  zero.at(0, 1) = 0.0;
+  REQUIRE_THROWS_WITH(zero.Normalize(),
+                      "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+  REQUIRE(zero.Get(1) == vectors[1]);
+  REQUIRE_THROWS_WITH(EuclideanVectorBatch{0},
+                      "EuclideanVectorBatch must have at least 1 dimension");
+}
+
+TEST_CASE("Testing operators on expiring vectors", "[rvalue]") {
+  std::vector<double> v1{1, 2, 3, 4, 5, 6};
+  std::vector<double> v2{6, 5, 4, 3, 2, 1};
+  EuclideanVector a{v1.begin(), v1.end()};
+  EuclideanVector b{v2.begin(), v2.end()};
+  EuclideanVector expected = a + b - a * 2.0;
+
+  // the whole chain is computed in the magnitudes of the temporary copy of a
+  EuclideanVector temporary{a};
+  const double* storage = &std::as_const(temporary)[0];
+  EuclideanVector result = std::move(temporary) + b - a * 2.0;
+  REQUIRE(result == expected);
+  REQUIRE(&std::as_const(result)[0] == storage);
+
+  // an expiring right hand operand is reused in the same way
+  EuclideanVector right{b};
+  storage = &std::as_const(right)[0];
+  result = a * 2.0 - std::move(right);
+  REQUIRE(result == a * 2.0 - b);
+  REQUIRE(&std::as_const(result)[0] == storage);
+
+  REQUIRE(EuclideanVector{a} + EuclideanVector{b} == a + b);
+  REQUIRE(EuclideanVector{a} - EuclideanVector{b} == a - b);
+  REQUIRE(2.0 * EuclideanVector{a} / 4.0 == a * 0.5);
+  REQUIRE(EuclideanVector{0} * 2.0 == EuclideanVector{1});
+
+  REQUIRE_THROWS_WITH(EuclideanVector{2} + a, "Dimensions of LHS(2) and RHS(6) do not match");
+  REQUIRE_THROWS_WITH(a - EuclideanVector{2}, "Dimensions of LHS(6) and RHS(2) do not match");
+  REQUIRE_THROWS_WITH(EuclideanVector{a} / 0, "Invalid vector division by 0");
+}
+
+TEST_CASE("Testing the cached euclidean norm", "[norm_cache]") {
+  std::vector<double> v{3.0, 4.0};
+  EuclideanVector a{v.begin(), v.end()};
+  REQUIRE(a.GetEuclideanNorm() == 5.0);
+
+  // every way of changing a magnitude clears the cached norm
+  a[0] = 0.0;
+  REQUIRE(a.GetEuclideanNorm() == 4.0);
+  a.at(1) = 12.0;
+  REQUIRE(a.GetEuclideanNorm() == 12.0);
+  a[0] += 5.0;
+  REQUIRE(a.GetEuclideanNorm() == 13.0);
+  a[1] = a[0];
+  REQUIRE(a.GetEuclideanNorm() == std::sqrt(50.0));
+  a[0] = 0.0;
+  REQUIRE(a.GetEuclideanNorm() == 5.0);
+  // a reference to a magnitude can't be copied into a variable that keeps writing into a
+  static_assert(!std::is_copy_constructible_v<EuclideanVector::MagnitudeReference>);
+  static_assert(!std::is_convertible_v<EuclideanVector::MagnitudeReference, double&>);
+
+  a *= 2;
+  REQUIRE(a.GetEuclideanNorm() == 10.0);
+  a /= 10;
+  REQUIRE(a.GetEuclideanNorm() == 1.0);
+  a += a;
+  REQUIRE(a.GetEuclideanNorm() == 2.0);
+  a -= a * 0.5;
+  REQUIRE(a.GetEuclideanNorm() == 1.0);
+  a = a * 3.0;
+  REQUIRE(a.GetEuclideanNorm() == 3.0);
+  a = EuclideanVector{v.begin(), v.end()};
+  REQUIRE(a.GetEuclideanNorm() == 5.0);
+
+  // copies and moves carry the cache with the magnitudes
+  EuclideanVector copy{a};
+  copy[1] = 0.0;
+  REQUIRE(copy.GetEuclideanNorm() == 3.0);
+  REQUIRE(a.GetEuclideanNorm() == 5.0);
+  copy = a;
+  REQUIRE(copy.GetEuclideanNorm() == 5.0);
+  EuclideanVector moved{std::move(copy)};
+  REQUIRE(moved.GetEuclideanNorm() == 5.0);
+  REQUIRE_THROWS_WITH(copy.GetEuclideanNorm(),
+                      "EuclideanVector with no dimensions does not have a norm");
+
+  REQUIRE(a.CreateUnitVector() == a / 5.0);
+  double d = a[1];
+  REQUIRE(d == 4.0);
+
+  // a const vector can be shared between threads, which all fill the cache at once
+  const EuclideanVector shared{v.begin(), v.end()};
+  std::vector<double> norms(4);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < norms.size(); ++i) {
+    threads.emplace_back([&shared, &norms, i] { norms[i] = shared.GetEuclideanNorm(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(norms == std::vector<double>(4, 5.0));
+}
+
+TEST_CASE("Testing SparseEuclideanVector", "[sparse]") {
+  // unsorted and repeated indices are sorted and summed, and zeros aren't stored
+  SparseEuclideanVector a{100000, {70000, 3, 9, 70000, 9}, {-1.0, 1.5, 2.0, -1.0, -2.0}};
+  REQUIRE(a.GetNumDimensions() == 100000);
+  REQUIRE(a.GetIndices() == std::vector<int>{3, 70000});
+  REQUIRE(a.GetValues() == std::vector<double>{1.5, -2.0});
+  REQUIRE(a.at(3) == 1.5);
+  REQUIRE(a.at(4) == 0.0);
+  REQUIRE_THROWS_WITH(a.at(100000), "Index 100000 is not valid for this EuclideanVector object");
+  REQUIRE_THROWS_WITH((SparseEuclideanVector{3, {3}, {1.0}}),
+                      "Index 3 is not valid for this EuclideanVector object");
+  REQUIRE_THROWS_WITH((SparseEuclideanVector{3, {0, 1}, {1.0}}),
+                      "Indices(2) and values(1) do not match");
+
+  std::stringstream out;
+  out << a;
+  REQUIRE(out.str() == "[3:1.5 70000:-2]");
+
+  // arithmetic between sparse vectors drops the magnitudes that cancel out
+  SparseEuclideanVector b = a * 2;
+  REQUIRE(a * b == 12.5);
+  REQUIRE(a.GetEuclideanNorm() == 2.5);
+  REQUIRE((b - a) == a);
+  REQUIRE((a - a).GetNumNonZeros() == 0);
+  SparseEuclideanVector c{100000, {3, 5}, {-1.5, 1.0}};
+  REQUIRE((a + c).GetIndices() == std::vector<int>{5, 70000});
+  c += a;
+  REQUIRE(c == SparseEuclideanVector(100000, {5, 70000}, {1.0, -2.0}));
+  c -= c;
+  REQUIRE(c == SparseEuclideanVector{100000});
+  REQUIRE((a * 0).GetNumNonZeros() == 0);
+  REQUIRE(b / 2 == a);
+  REQUIRE_THROWS_WITH(b / 0, "Invalid vector division by 0");
+  REQUIRE(a.CreateUnitVector() == a / 2.5);
+  REQUIRE_THROWS_WITH(c.CreateUnitVector(),
+                      "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+  REQUIRE_THROWS_WITH(a + SparseEuclideanVector{3},
+                      "Dimensions of LHS(100000) and RHS(3) do not match");
+
+  a.Set(4, 7.0);
+  a.Set(3, 0.0);
+  REQUIRE(a.GetIndices() == std::vector<int>{4, 70000});
+  REQUIRE(a != b);
+
+  // mixing with dense vectors
+  std::vector<double> v{1.0, 0.0, -2.0, 0.0};
+  EuclideanVector dense{v.begin(), v.end()};
+  SparseEuclideanVector s{dense};
+  REQUIRE(s.GetIndices() == std::vector<int>{0, 2});
+  REQUIRE(EuclideanVector{s} == dense);
+  SparseEuclideanVector t{4, {1, 2}, {3.0, 1.0}};
+  REQUIRE(t * dense == -2.0);
+  REQUIRE(dense * t == -2.0);
+  REQUIRE(dense + t == EuclideanVector{s + t});
+  REQUIRE(t + dense == EuclideanVector{s + t});
+  REQUIRE(dense - t == EuclideanVector{s - t});
+  REQUIRE(t - dense == EuclideanVector{t - s});
+  REQUIRE_THROWS_WITH(t * EuclideanVector{3},
+                      "Dimensions of LHS(4) and RHS(3) do not match");
+}
+
+TEST_CASE("Testing EuclideanVectorIndex", "[index]") {
+  // points spread over the unit cube, from a fixed seed
+  constexpr int kDimensions = 8;
+  std::mt19937 random{7};
+  std::uniform_real_distribution<double> uniform{-1.0, 1.0};
+  EuclideanVectorBatch batch{kDimensions};
+  for (int i = 0; i < 2000; ++i) {
+    EuclideanVector ev{kDimensions};
+    for (int d = 0; d < kDimensions; ++d) {
+      ev[d] = uniform(random);
+    }
+    batch.PushBack(ev);
+  }
+
+  EuclideanVectorIndex empty{kDimensions};
+  REQUIRE(empty.Search(batch.Get(0), 5).empty());
+
+  EuclideanVectorIndex::Options options = EuclideanVectorIndex::kDefaultOptions;
+  options.max_neighbours_ = 8;
+  options.ef_construction_ = 100;
+  for (auto metric : {EuclideanVectorIndex::Metric::kL2, EuclideanVectorIndex::Metric::kCosine,
+                      EuclideanVectorIndex::Metric::kInnerProduct}) {
+    EuclideanVectorIndex index{kDimensions, metric, options};
+    // built from several threads, then added to one vector at a time
+    index.Insert(batch, 4);
+    REQUIRE(index.GetSize() == 2000);
+    REQUIRE(index.Insert(EuclideanVector{kDimensions, 0.5}) == 2000);
+
+    auto distance = [&](const EuclideanVector& v, const EuclideanVector& query) {
+      switch (metric) {
+        case EuclideanVectorIndex::Metric::kL2:
+          return EuclideanVector{v - query}.GetEuclideanNorm();
+        case EuclideanVectorIndex::Metric::kCosine:
+          return 1 - v * query.CreateUnitVector();
+        default:
+          return -(v * query);
+      }
+    };
+    // the exact nearest neighbours by brute force, to measure recall against
+    auto exact = [&](const EuclideanVector& query, int k) {
+      std::vector<std::pair<double, int>> all;
+      for (int i = 0; i < index.GetSize(); ++i) {
+        all.emplace_back(distance(index.Get(i), query), i);
+      }
+      std::partial_sort(all.begin(), all.begin() + k, all.end());
+      all.resize(k);
+      return all;
+    };
+    int hits = 0;
+    for (int q = 0; q < 50; ++q) {
+      EuclideanVector query{kDimensions};
+      for (int d = 0; d < kDimensions; ++d) {
+        query[d] = uniform(random);
+      }
+      std::vector<EuclideanVectorIndex::Neighbour> found = index.Search(query, 10);
+      REQUIRE(found.size() == 10);
+      auto expected = exact(query, 10);
+      for (std::size_t i = 0; i < found.size(); ++i) {
+        REQUIRE(found[i].distance_ == Approx(distance(index.Get(found[i].id_), query)));
+        REQUIRE((i == 0 || found[i - 1].distance_ <= found[i].distance_));
+      }
+      for (const auto& neighbour : found) {
+        hits += std::any_of(expected.begin(), expected.end(),
+                            [&](const auto& e) { return e.second == neighbour.id_; });
+      }
+    }
+    REQUIRE(hits >= 0.95 * 50 * 10);
+
+    // ef is raised to k
+    REQUIRE(index.Search(batch.Get(3), 100, 1).size() == 100);
+  }
+
+  EuclideanVectorIndex index{kDimensions};
+  index.Insert(batch, 1);
+  REQUIRE(index.Search(batch.Get(42), 1)[0].id_ == 42);
+  REQUIRE(index.Search(batch.Get(42), 1)[0].distance_ == 0.0);
+  REQUIRE(index.Get(42) == batch.Get(42));
+  REQUIRE(index.Search(batch.Get(42), 0).empty());
+  REQUIRE_THROWS_WITH(index.Get(2000),
+                      "Index 2000 is not valid for this EuclideanVectorIndex object");
+  REQUIRE_THROWS_WITH(index.Insert(EuclideanVector{3}),
+                      "Dimensions of LHS(8) and RHS(3) do not match");
+  REQUIRE_THROWS_WITH(index.Search(EuclideanVector{3}, 1),
+                      "Dimensions of LHS(8) and RHS(3) do not match");
+  REQUIRE_THROWS_WITH(EuclideanVectorIndex(0),
+                      "EuclideanVectorIndex must have at least 1 dimension");
+
+  EuclideanVectorIndex cosine{kDimensions, EuclideanVectorIndex::Metric::kCosine};
+  REQUIRE_THROWS_WITH(cosine.Insert(EuclideanVector{kDimensions}),
+                      "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+  REQUIRE(cosine.GetSize() == 0);
+}
+
+TEST_CASE("Testing EuclideanVectorView", "[view]") {
+  std::vector<double> magnitudes{3.0, 4.0, 0.0, 1.0, 2.0, 2.0};
+  EuclideanVectorView a{magnitudes.data(), 3};
+  EuclideanVectorView b{magnitudes.data() + 3, 3};
+  REQUIRE(a.GetNumDimensions() == 3);
+  REQUIRE(a[1] == 4.0);
+  REQUIRE(a.at(2) == 0.0);
+  REQUIRE_THROWS_WITH(a.at(3), "Index 3 is not valid for this EuclideanVector object");
+
+  std::stringstream out;
+  out << a;
+  REQUIRE(out.str() == "[3 4 0]");
+
+  // views take part in expressions with each other and with EuclideanVectors
+  std::vector<double> v{1.0, 1.0, 1.0};
+  std::vector<double> sum{4.0, 6.0, 2.0};
+  EuclideanVector ev{v.begin(), v.end()};
+  REQUIRE(EuclideanVector{a + b} == EuclideanVector(sum.begin(), sum.end()));
+  REQUIRE(a * b == 11.0);
+  REQUIRE(a * ev == 7.0);
+  REQUIRE(ev - a * 2.0 == EuclideanVector{ev - a - a});
+  REQUIRE(EuclideanVector{b / 2} == EuclideanVector{b * 0.5});
+  REQUIRE_THROWS_WITH(a / 0, "Invalid vector division by 0");
+  REQUIRE_THROWS_WITH(a + EuclideanVectorView(magnitudes.data(), 2),
+                      "Dimensions of LHS(3) and RHS(2) do not match");
+  ev += b;
+  REQUIRE(ev == EuclideanVector{b + EuclideanVector{3, 1.0}});
+  REQUIRE(a.GetEuclideanNorm() == 5.0);
+  REQUIRE(a.CreateUnitVector() == a / 5.0);
+  REQUIRE_THROWS_WITH((EuclideanVectorView{magnitudes.data() + 2, 1}.CreateUnitVector()),
+                      "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+
+  // a view of an EuclideanVector sees it change
+  EuclideanVectorView view{ev};
+  REQUIRE(view == EuclideanVectorView{ev});
+  ev[0] = 9.0;
+  REQUIRE(view[0] == 9.0);
+  REQUIRE(view != a);
+  REQUIRE(std::vector<double>(view) == std::vector<double>(ev));
+}
+
+TEST_CASE("Testing EuclideanVectorDataset", "[dataset]") {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "euclidean_vector_test.ev").string();
+  std::vector<double> v{1.0, 2.0, 3.0};
+  EuclideanVector ev{v.begin(), v.end()};
+  {
+    EuclideanVectorWriter writer{path, 3};
+    for (int i = 0; i < 100; ++i) {
+      writer.Write(ev * i);
+    }
+    REQUIRE_THROWS_WITH(writer.Write(EuclideanVector{2}),
+                        "Dimensions of LHS(3) and RHS(2) do not match");
+    REQUIRE(writer.GetSize() == 100);
+  }
+
+  EuclideanVectorDataset dataset{path};
+  REQUIRE(dataset.GetNumDimensions() == 3);
+  REQUIRE(dataset.GetSize() == 100);
+  // the magnitudes are read in place from the cache line aligned mapping
+  REQUIRE(reinterpret_cast<std::uintptr_t>(dataset[0].Magnitudes()) % 64 == 0);
+  REQUIRE(dataset[1].Magnitudes() == dataset[0].Magnitudes() + 3);
+  REQUIRE(dataset[7] == EuclideanVectorView{EuclideanVector{ev * 7}});
+  REQUIRE(EuclideanVector{dataset[99]} == ev * 99);
+  REQUIRE(dataset[2] * dataset[3] == 6 * (ev * ev));
+  REQUIRE(EuclideanVector{dataset[4] - dataset[2]} == ev * 2);
+  REQUIRE(dataset.at(1).GetEuclideanNorm() == ev.GetEuclideanNorm());
+  REQUIRE_THROWS_WITH(dataset.at(100),
+                      "Index 100 is not valid for this EuclideanVectorDataset object");
+
+  // views remain valid when the dataset is moved
+  EuclideanVectorView view = dataset[5];
+  EuclideanVectorDataset moved{std::move(dataset)};
+  REQUIRE(EuclideanVector{view} == ev * 5);
+  REQUIRE(moved.GetSize() == 100);
+
+  // a dataset round trips through another writer
+  std::string copy = path + ".copy";
+  {
+    EuclideanVectorWriter writer{copy, 3};
+    writer.Write(moved[10]);
+    writer.Close();
+    REQUIRE_THROWS_WITH(writer.Write(moved[11]),
+                        "Could not write to " + copy + " as it is closed");
+  }
+  REQUIRE(EuclideanVectorDataset{copy}[0] == moved[10]);
+
+  // assigning over a writer completes the file it was writing
+  std::string other = path + ".other";
+  {
+    EuclideanVectorWriter writer{copy, 3};
+    writer.Write(moved[12]);
+    writer.Write(moved[13]);
+    writer = EuclideanVectorWriter{other, 3};
+    REQUIRE(writer.GetSize() == 0);
+    writer.Write(moved[14]);
+  }
+  REQUIRE(EuclideanVectorDataset{copy}.GetSize() == 2);
+  REQUIRE(EuclideanVectorDataset{copy}[1] == moved[13]);
+  REQUIRE(EuclideanVectorDataset{other}.GetSize() == 1);
+  REQUIRE(EuclideanVectorDataset{other}[0] == moved[14]);
+  std::filesystem::remove(other);
+
+  std::ofstream{copy, std::ios::binary} << "not a dataset, but long enough to hold a header if it "
+                                           "were one, which it isn't";
+  REQUIRE_THROWS_WITH(EuclideanVectorDataset{copy}, copy + " is not an EuclideanVector dataset");
+  std::filesystem::remove(copy);
+  REQUIRE_THROWS_WITH(EuclideanVectorDataset{copy}, "Could not read " + copy);
+  REQUIRE_THROWS_WITH(EuclideanVectorWriter(path, 0),
+                      "EuclideanVectorWriter must have at least 1 dimension");
+  std::filesystem::remove(path);
+}
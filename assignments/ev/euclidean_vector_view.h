@@ -0,0 +1,98 @@
+/*
+* A read-only view of magnitudes stored elsewhere, such as in a memory mapped dataset.
+*
+* An EuclideanVectorView is just a pointer and a number of dimensions: making one copies no
+* magnitudes. It takes part in the same expressions as an EuclideanVector, so a view can be
+* added to, subtracted from, scaled and dotted with views, EuclideanVectors and expressions,
+* and converts implicitly to an EuclideanVector, which is the only point its magnitudes are
+* copied. Expressions over views and EuclideanVectors run on the same SIMD kernels.
+*
+* The magnitudes must outlive the view, and every expression built from it.
+*/
+
+#ifndef ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_VIEW_H_
+#define ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_VIEW_H_
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "assignments/ev/euclidean_vector.h"
+#include "assignments/ev/euclidean_vector_kernels.h"
+
+class EuclideanVectorView;
+template <>
+struct HasContiguousMagnitudes<EuclideanVectorView> : std::true_type {};
+
+// Example:
+//  std::vector<double> magnitudes{3, 4};
+//  EuclideanVectorView view{magnitudes.data(), 2};
+//  std::cout << EuclideanVector{view * 2.0};
+// Outputs -> [6 8]
+class EuclideanVectorView : public VectorExpression<EuclideanVectorView> {
+ public:
+  /************** constructors ******************/
+  // Views the num_dimensions magnitudes starting at magnitudes
+  EuclideanVectorView(const double* magnitudes, int num_dimensions) noexcept
+    : magnitudes_{magnitudes}, num_dimensions_{num_dimensions} {}
+
+  // Views the magnitudes of ev, until ev is next resized or destroyed
+  explicit EuclideanVectorView(const EuclideanVector& ev) noexcept
+    : magnitudes_{ev.GetNumDimensions() == 0 ? nullptr : &ev[0]},
+      num_dimensions_{ev.GetNumDimensions()} {}
+
+  /************** friend overloads ******************/
+  friend std::ostream& operator<<(std::ostream& os, const EuclideanVectorView& v) noexcept {
+    os << "[";
+    for (int i = 0; i < v.num_dimensions_; ++i) {
+      os << v.magnitudes_[i] << (i == v.num_dimensions_ - 1 ? "" : " ");
+    }
+    os << "]";
+    return os;
+  }
+  friend bool operator==(const EuclideanVectorView& lhs, const EuclideanVectorView& rhs) noexcept {
+    return lhs.num_dimensions_ == rhs.num_dimensions_ &&
+           std::equal(lhs.magnitudes_, lhs.magnitudes_ + lhs.num_dimensions_, rhs.magnitudes_);
+  }
+  friend bool operator!=(const EuclideanVectorView& lhs, const EuclideanVectorView& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+  /************** operations ******************/
+  const double& operator[](int index) const noexcept { return magnitudes_[index]; }
+  explicit operator std::vector<double>() const {
+    return std::vector<double>(magnitudes_, magnitudes_ + num_dimensions_);
+  }
+
+  /************** methods ******************/
+  int GetNumDimensions() const noexcept { return num_dimensions_; }
+  const double* Magnitudes() const noexcept { return magnitudes_; }
+  void EvaluateInto(double* out) const noexcept {
+    std::copy(magnitudes_, magnitudes_ + num_dimensions_, out);
+  }
+  // Unlike EuclideanVector, the norm is never cached, as the magnitudes may change underneath
+  double GetEuclideanNorm() const {
+    if (num_dimensions_ == 0) {
+      throw EuclideanVectorError("EuclideanVector with no dimensions does not have a norm");
+    }
+    return std::sqrt(ev_kernels::Active().sum_of_squares_(magnitudes_, num_dimensions_));
+  }
+  EuclideanVector CreateUnitVector() const {
+    if (num_dimensions_ == 0) {
+      throw EuclideanVectorError("EuclideanVector with no dimensions does not have a unit vector");
+    }
+    double norm = GetEuclideanNorm();
+    if (norm == 0) {
+      throw EuclideanVectorError(
+          "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+    }
+    return *this / norm;
+  }
+
+ private:
+  const double* magnitudes_;
+  int num_dimensions_;
+};
+
+#endif  // ASSIGNMENTS_EV_EUCLIDEAN_VECTOR_VIEW_H_
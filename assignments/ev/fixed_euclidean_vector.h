@@ -0,0 +1,197 @@
+/*
+* A Euclidean Vector whose number of dimensions is part of its type.
+*
+* EuclideanVector decides its number of dimensions at runtime, so every vector carries a
+* num_dimensions_, and adding two vectors checks that their dimensions match. When the
+* dimensions are known in advance, as with 2D or 3D physics, FixedEuclideanVector<D> keeps
+* its magnitudes in a std::array instead. Adding vectors of different dimensions doesn't
+* compile, and every operation is a constexpr expression over exactly D elements, which the
+* compiler unrolls and vectorises.
+*
+* A FixedEuclideanVector converts explicitly to and from an EuclideanVector. Conversion from
+* an EuclideanVector checks the dimensions at runtime.
+*/
+
+#ifndef ASSIGNMENTS_EV_FIXED_EUCLIDEAN_VECTOR_H_
+#define ASSIGNMENTS_EV_FIXED_EUCLIDEAN_VECTOR_H_
+
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "assignments/ev/euclidean_vector.h"
+
+// Example:
+//  constexpr FixedEuclideanVector<3> a{1, 2, 3};
+//  constexpr FixedEuclideanVector<3> b = a * 2.0;
+//  static_assert(a * b == 28);
+template <int D, typename T = double>
+class FixedEuclideanVector {
+  static_assert(D > 0, "A FixedEuclideanVector needs at least 1 dimension");
+  static_assert(std::is_arithmetic<T>::value, "A FixedEuclideanVector holds arithmetic values");
+
+ public:
+  /************** constructors ******************/
+  // Every magnitude is 0
+  constexpr FixedEuclideanVector() noexcept : magnitudes_{} {}
+
+  // One magnitude for each of the D dimensions
+  template <typename... Magnitudes,
+            typename = std::enable_if_t<
+                sizeof...(Magnitudes) == D &&
+                std::conjunction<std::is_arithmetic<Magnitudes>...>::value>>
+  constexpr FixedEuclideanVector(Magnitudes... magnitudes) noexcept  // NOLINT(runtime/explicit)
+      : magnitudes_{{static_cast<T>(magnitudes)...}} {}
+
+  constexpr explicit FixedEuclideanVector(const std::array<T, D>& magnitudes) noexcept
+      : magnitudes_{magnitudes} {}
+
+  // Throws an EuclideanVectorError if ev doesn't have D dimensions
+  explicit FixedEuclideanVector(const EuclideanVector& ev) : magnitudes_{} {
+    if (ev.GetNumDimensions() != D) {
+      std::string error_message = "Dimensions of LHS(" + std::to_string(D) + ") and RHS(" +
+                                  std::to_string(ev.GetNumDimensions()) + ") do not match";
+      throw EuclideanVectorError(error_message);
+    }
+    for (int i = 0; i < D; ++i) {
+      magnitudes_[i] = static_cast<T>(ev[i]);
+    }
+  }
+
+  // Every magnitude is value
+  static constexpr FixedEuclideanVector Filled(T value) noexcept {
+    return Generate([value](int) { return value; }, std::make_integer_sequence<int, D>{});
+  }
+
+  /************** friend overloads ******************/
+  friend std::ostream& operator<<(std::ostream& os, const FixedEuclideanVector& v) noexcept {
+    os << "[";
+    for (int i = 0; i < D; ++i) {
+      os << v.magnitudes_[i] << (i == D - 1 ? "]" : " ");
+    }
+    return os;
+  }
+  friend constexpr FixedEuclideanVector operator+(const FixedEuclideanVector& lhs,
+                                                  const FixedEuclideanVector& rhs) noexcept {
+    return Generate([&](int i) { return lhs.magnitudes_[i] + rhs.magnitudes_[i]; },
+                    std::make_integer_sequence<int, D>{});
+  }
+  friend constexpr FixedEuclideanVector operator-(const FixedEuclideanVector& lhs,
+                                                  const FixedEuclideanVector& rhs) noexcept {
+    return Generate([&](int i) { return lhs.magnitudes_[i] - rhs.magnitudes_[i]; },
+                    std::make_integer_sequence<int, D>{});
+  }
+  // The dot product
+  friend constexpr T operator*(const FixedEuclideanVector& lhs,
+                               const FixedEuclideanVector& rhs) noexcept {
+    return Dot(lhs, rhs, std::make_integer_sequence<int, D>{});
+  }
+  friend constexpr FixedEuclideanVector operator*(const FixedEuclideanVector& v,
+                                                  T scalar) noexcept {
+    return Generate([&](int i) { return v.magnitudes_[i] * scalar; },
+                    std::make_integer_sequence<int, D>{});
+  }
+  friend constexpr FixedEuclideanVector operator*(T scalar,
+                                                  const FixedEuclideanVector& v) noexcept {
+    return v * scalar;
+  }
+  // Throws an EuclideanVectorError when dividing by 0
+  friend constexpr FixedEuclideanVector operator/(const FixedEuclideanVector& v, T scalar) {
+    if (scalar == 0) {
+      throw EuclideanVectorError("Invalid vector division by 0");
+    }
+    return Generate([&](int i) { return v.magnitudes_[i] / scalar; },
+                    std::make_integer_sequence<int, D>{});
+  }
+  friend constexpr bool operator==(const FixedEuclideanVector& lhs,
+                                   const FixedEuclideanVector& rhs) noexcept {
+    return Equal(lhs, rhs, std::make_integer_sequence<int, D>{});
+  }
+  friend constexpr bool operator!=(const FixedEuclideanVector& lhs,
+                                   const FixedEuclideanVector& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+  /************** operations ******************/
+  constexpr FixedEuclideanVector& operator+=(const FixedEuclideanVector& v) noexcept {
+    return *this = *this + v;
+  }
+  constexpr FixedEuclideanVector& operator-=(const FixedEuclideanVector& v) noexcept {
+    return *this = *this - v;
+  }
+  constexpr FixedEuclideanVector& operator*=(T scalar) noexcept { return *this = *this * scalar; }
+  constexpr FixedEuclideanVector& operator/=(T scalar) { return *this = *this / scalar; }
+  constexpr T& operator[](int index) noexcept { return magnitudes_[index]; }
+  constexpr const T& operator[](int index) const noexcept { return magnitudes_[index]; }
+  explicit operator EuclideanVector() const {
+    std::vector<double> magnitudes(magnitudes_.begin(), magnitudes_.end());
+    return EuclideanVector{magnitudes.cbegin(), magnitudes.cend()};
+  }
+  explicit operator std::vector<T>() const {
+    return std::vector<T>(magnitudes_.begin(), magnitudes_.end());
+  }
+
+  /************** methods ******************/
+  static constexpr int GetNumDimensions() noexcept { return D; }
+  // Throws an EuclideanVectorError if index is out of bounds
+  constexpr T& at(int index) {
+    CheckIndex(index);
+    return magnitudes_[index];
+  }
+  constexpr const T& at(int index) const {
+    CheckIndex(index);
+    return magnitudes_[index];
+  }
+  constexpr T GetSquaredNorm() const noexcept { return *this * *this; }
+  // std::sqrt isn't constexpr, so neither is this
+  double GetEuclideanNorm() const noexcept {
+    return std::sqrt(static_cast<double>(GetSquaredNorm()));
+  }
+  // Throws an EuclideanVectorError if the norm is 0
+  FixedEuclideanVector<D, double> CreateUnitVector() const {
+    double norm = GetEuclideanNorm();
+    if (norm == 0) {
+      throw EuclideanVectorError(
+          "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+    }
+    FixedEuclideanVector<D, double> unit;
+    for (int i = 0; i < D; ++i) {
+      unit[i] = magnitudes_[i] / norm;
+    }
+    return unit;
+  }
+  constexpr const std::array<T, D>& GetMagnitudes() const noexcept { return magnitudes_; }
+
+ private:
+  // Builds a vector from element(i) for every i, as one expression with no loop
+  template <typename Element, int... I>
+  static constexpr FixedEuclideanVector Generate(Element element,
+                                                 std::integer_sequence<int, I...>) noexcept {
+    return FixedEuclideanVector{std::array<T, D>{{static_cast<T>(element(I))...}}};
+  }
+  template <int... I>
+  static constexpr T Dot(const FixedEuclideanVector& lhs, const FixedEuclideanVector& rhs,
+                         std::integer_sequence<int, I...>) noexcept {
+    return ((lhs.magnitudes_[I] * rhs.magnitudes_[I]) + ...);
+  }
+  // std::array's operator== isn't constexpr until C++20
+  template <int... I>
+  static constexpr bool Equal(const FixedEuclideanVector& lhs, const FixedEuclideanVector& rhs,
+                              std::integer_sequence<int, I...>) noexcept {
+    return ((lhs.magnitudes_[I] == rhs.magnitudes_[I]) && ...);
+  }
+  constexpr void CheckIndex(int index) const {
+    if (index < 0 || index >= D) {
+      throw EuclideanVectorError("Index " + std::to_string(index) +
+                                 " is not valid for this EuclideanVector object");
+    }
+  }
+
+  std::array<T, D> magnitudes_;
+};
+
+#endif  // ASSIGNMENTS_EV_FIXED_EUCLIDEAN_VECTOR_H_
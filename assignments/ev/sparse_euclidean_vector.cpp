@@ -0,0 +1,318 @@
+#include "assignments/ev/sparse_euclidean_vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+
+#include "assignments/ev/euclidean_vector_kernels.h"
+
+namespace {
+
+void CheckDimensions(int lhs, int rhs) {
+  if (lhs != rhs) {
+    std::string error_message = "Dimensions of LHS(" + std::to_string(lhs) + ") and RHS(" +
+                                std::to_string(rhs) + ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+}
+
+// Removes the pairs whose value has become 0, keeping the rest in order
+void DropZeros(std::vector<int>& indices, std::vector<double>& values) noexcept {
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (values[i] != 0) {
+      indices[kept] = indices[i];
+      values[kept++] = values[i];
+    }
+  }
+  indices.resize(kept);
+  values.resize(kept);
+}
+
+}  // namespace
+
+/********************* CONSTRUCTORS *************************************/
+
+SparseEuclideanVector::SparseEuclideanVector(int num_dimensions) noexcept
+  : num_dimensions_{num_dimensions} {}
+
+// The pairs are sorted by index, then runs of the same index are summed, and zeros dropped
+SparseEuclideanVector::SparseEuclideanVector(int num_dimensions, const std::vector<int>& indices,
+                                             const std::vector<double>& values)
+  : num_dimensions_{num_dimensions} {
+  if (indices.size() != values.size()) {
+    std::string error_message = "Indices(" + std::to_string(indices.size()) + ") and values(" +
+                                std::to_string(values.size()) + ") do not match";
+    throw EuclideanVectorError(error_message);
+  }
+  for (int index : indices) {
+    CheckIndex(index);
+  }
+  std::vector<std::size_t> order(indices.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) { return indices[a] < indices[b]; });
+  for (std::size_t i = 0; i < order.size();) {
+    int index = indices[order[i]];
+    double value = 0;
+    for (; i < order.size() && indices[order[i]] == index; ++i) {
+      value += values[order[i]];
+    }
+    if (value != 0) {
+      indices_.push_back(index);
+      values_.push_back(value);
+    }
+  }
+}
+
+SparseEuclideanVector::SparseEuclideanVector(const EuclideanVector& ev)
+  : num_dimensions_{ev.GetNumDimensions()} {
+  for (int i = 0; i < num_dimensions_; ++i) {
+    if (ev[i] != 0) {
+      indices_.push_back(i);
+      values_.push_back(ev[i]);
+    }
+  }
+}
+
+/********************* METHODS *************************************/
+
+// The non-zeros are found by binary search
+double SparseEuclideanVector::at(int index) const {
+  CheckIndex(index);
+  auto it = std::lower_bound(indices_.begin(), indices_.end(), index);
+  if (it == indices_.end() || *it != index) {
+    return 0.0;
+  }
+  return values_[it - indices_.begin()];
+}
+
+void SparseEuclideanVector::Set(int index, double value) {
+  CheckIndex(index);
+  auto it = std::lower_bound(indices_.begin(), indices_.end(), index);
+  auto position = it - indices_.begin();
+  bool stored = it != indices_.end() && *it == index;
+  if (value == 0) {
+    if (stored) {
+      indices_.erase(it);
+      values_.erase(values_.begin() + position);
+    }
+  } else if (stored) {
+    values_[position] = value;
+  } else {
+    indices_.insert(it, index);
+    values_.insert(values_.begin() + position, value);
+  }
+}
+
+// Only the non-zero magnitudes contribute to the sum of squares
+double SparseEuclideanVector::GetEuclideanNorm() const {
+  if (num_dimensions_ == 0) {
+    throw EuclideanVectorError("EuclideanVector with no dimensions does not have a norm");
+  }
+  return std::sqrt(
+      ev_kernels::Active().sum_of_squares_(values_.data(), static_cast<int>(values_.size())));
+}
+
+SparseEuclideanVector SparseEuclideanVector::CreateUnitVector() const {
+  if (num_dimensions_ == 0) {
+    throw EuclideanVectorError("EuclideanVector with no dimensions does not have a unit vector");
+  }
+  double norm = GetEuclideanNorm();
+  if (norm == 0) {
+    throw EuclideanVectorError(
+        "EuclideanVector with euclidean normal of 0 does not have a unit vector");
+  }
+  return *this / norm;
+}
+
+SparseEuclideanVector::operator EuclideanVector() const {
+  EuclideanVector ev{num_dimensions_};
+  for (std::size_t i = 0; i < indices_.size(); ++i) {
+    ev[indices_[i]] = values_[i];
+  }
+  return ev;
+}
+
+/********************* FRIEND OVERLOADS *************************************/
+
+std::ostream& operator<<(std::ostream& os, const SparseEuclideanVector& v) noexcept {
+  os << "[";
+  for (std::size_t i = 0; i < v.indices_.size(); ++i) {
+    os << (i == 0 ? "" : " ") << v.indices_[i] << ":" << v.values_[i];
+  }
+  os << "]";
+  return os;
+}
+
+SparseEuclideanVector operator+(const SparseEuclideanVector& lhs,
+                                const SparseEuclideanVector& rhs) {
+  return SparseEuclideanVector::Merge(lhs, rhs, 1.0);
+}
+
+SparseEuclideanVector operator-(const SparseEuclideanVector& lhs,
+                                const SparseEuclideanVector& rhs) {
+  return SparseEuclideanVector::Merge(lhs, rhs, -1.0);
+}
+
+EuclideanVector operator+(const SparseEuclideanVector& lhs, const EuclideanVector& rhs) {
+  CheckDimensions(lhs.num_dimensions_, rhs.GetNumDimensions());
+  return SparseEuclideanVector::AddToDense(rhs, lhs, 1.0);
+}
+
+EuclideanVector operator+(const EuclideanVector& lhs, const SparseEuclideanVector& rhs) {
+  CheckDimensions(lhs.GetNumDimensions(), rhs.num_dimensions_);
+  return SparseEuclideanVector::AddToDense(lhs, rhs, 1.0);
+}
+
+// lhs - rhs is computed as -rhs + lhs
+EuclideanVector operator-(const SparseEuclideanVector& lhs, const EuclideanVector& rhs) {
+  CheckDimensions(lhs.num_dimensions_, rhs.GetNumDimensions());
+  return SparseEuclideanVector::AddToDense(rhs * -1.0, lhs, 1.0);
+}
+
+EuclideanVector operator-(const EuclideanVector& lhs, const SparseEuclideanVector& rhs) {
+  CheckDimensions(lhs.GetNumDimensions(), rhs.num_dimensions_);
+  return SparseEuclideanVector::AddToDense(lhs, rhs, -1.0);
+}
+
+// Walks both index arrays together, only multiplying where they meet
+double operator*(const SparseEuclideanVector& lhs, const SparseEuclideanVector& rhs) {
+  CheckDimensions(lhs.num_dimensions_, rhs.num_dimensions_);
+  double sum = 0;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < lhs.indices_.size() && j < rhs.indices_.size()) {
+    if (lhs.indices_[i] < rhs.indices_[j]) {
+      ++i;
+    } else if (rhs.indices_[j] < lhs.indices_[i]) {
+      ++j;
+    } else {
+      sum += lhs.values_[i++] * rhs.values_[j++];
+    }
+  }
+  return sum;
+}
+
+// Gathers the dense magnitudes at the sparse indices
+double operator*(const SparseEuclideanVector& lhs, const EuclideanVector& rhs) {
+  CheckDimensions(lhs.num_dimensions_, rhs.GetNumDimensions());
+  double sum = 0;
+  for (std::size_t i = 0; i < lhs.indices_.size(); ++i) {
+    sum += lhs.values_[i] * rhs[lhs.indices_[i]];
+  }
+  return sum;
+}
+
+double operator*(const EuclideanVector& lhs, const SparseEuclideanVector& rhs) {
+  CheckDimensions(lhs.GetNumDimensions(), rhs.num_dimensions_);
+  return rhs * lhs;
+}
+
+SparseEuclideanVector operator*(const SparseEuclideanVector& v, double scalar) noexcept {
+  SparseEuclideanVector result{v};
+  result *= scalar;
+  return result;
+}
+
+SparseEuclideanVector operator*(double scalar, const SparseEuclideanVector& v) noexcept {
+  return v * scalar;
+}
+
+SparseEuclideanVector operator/(const SparseEuclideanVector& v, double scalar) {
+  SparseEuclideanVector result{v};
+  result /= scalar;
+  return result;
+}
+
+// Zeros are never stored, so equal vectors have equal index and value arrays
+bool operator==(const SparseEuclideanVector& lhs, const SparseEuclideanVector& rhs) noexcept {
+  return lhs.num_dimensions_ == rhs.num_dimensions_ && lhs.indices_ == rhs.indices_ &&
+         lhs.values_ == rhs.values_;
+}
+
+bool operator!=(const SparseEuclideanVector& lhs, const SparseEuclideanVector& rhs) noexcept {
+  return !(lhs == rhs);
+}
+
+/********************* OVERLOADS *************************************/
+
+SparseEuclideanVector& SparseEuclideanVector::operator+=(const SparseEuclideanVector& v) {
+  return *this = *this + v;
+}
+
+SparseEuclideanVector& SparseEuclideanVector::operator-=(const SparseEuclideanVector& v) {
+  return *this = *this - v;
+}
+
+// Scaling by 0 (or by a scalar small enough to underflow) removes the zeros it makes
+SparseEuclideanVector& SparseEuclideanVector::operator*=(double scalar) noexcept {
+  int n = static_cast<int>(values_.size());
+  ev_kernels::Active().scale_(values_.data(), scalar, values_.data(), n);
+  DropZeros(indices_, values_);
+  return *this;
+}
+
+SparseEuclideanVector& SparseEuclideanVector::operator/=(double scalar) {
+  if (scalar == 0) {
+    throw EuclideanVectorError("Invalid vector division by 0");
+  }
+  int n = static_cast<int>(values_.size());
+  ev_kernels::Active().divide_(values_.data(), scalar, values_.data(), n);
+  DropZeros(indices_, values_);
+  return *this;
+}
+
+/********************* PRIVATE *************************************/
+
+SparseEuclideanVector SparseEuclideanVector::Merge(const SparseEuclideanVector& lhs,
+                                                   const SparseEuclideanVector& rhs,
+                                                   double sign) {
+  CheckDimensions(lhs.num_dimensions_, rhs.num_dimensions_);
+  SparseEuclideanVector result{lhs.num_dimensions_};
+  result.indices_.reserve(lhs.indices_.size() + rhs.indices_.size());
+  result.values_.reserve(lhs.indices_.size() + rhs.indices_.size());
+  auto push = [&result](int index, double value) {
+    if (value != 0) {
+      result.indices_.push_back(index);
+      result.values_.push_back(value);
+    }
+  };
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < lhs.indices_.size() || j < rhs.indices_.size()) {
+    bool lhs_left = i < lhs.indices_.size();
+    bool rhs_left = j < rhs.indices_.size();
+    if (!rhs_left || (lhs_left && lhs.indices_[i] < rhs.indices_[j])) {
+      push(lhs.indices_[i], lhs.values_[i]);
+      ++i;
+    } else if (!lhs_left || rhs.indices_[j] < lhs.indices_[i]) {
+      push(rhs.indices_[j], sign * rhs.values_[j]);
+      ++j;
+    } else {
+      push(lhs.indices_[i], lhs.values_[i] + sign * rhs.values_[j]);
+      ++i;
+      ++j;
+    }
+  }
+  return result;
+}
+
+EuclideanVector SparseEuclideanVector::AddToDense(const EuclideanVector& ev,
+                                                  const SparseEuclideanVector& sparse,
+                                                  double sign) {
+  EuclideanVector result{ev};
+  for (std::size_t i = 0; i < sparse.indices_.size(); ++i) {
+    result[sparse.indices_[i]] += sign * sparse.values_[i];
+  }
+  return result;
+}
+
+void SparseEuclideanVector::CheckIndex(int index) const {
+  if (index < 0 || index >= num_dimensions_) {
+    std::string error_message =
+        "Index " + std::to_string(index) + " is not valid for this EuclideanVector object";
+    throw EuclideanVectorError(error_message);
+  }
+}
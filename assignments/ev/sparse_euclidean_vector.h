@@ -0,0 +1,100 @@
+/*
+* A Euclidean Vector that stores only its non-zero magnitudes.
+*
+* Feature vectors often have a huge number of dimensions but only a few non-zero magnitudes.
+* A SparseEuclideanVector keeps the indices of those magnitudes in one sorted array and their
+* values in another, so its memory, and the cost of its dot products, norms and sums, grow
+* with the number of non-zeros rather than the number of dimensions.
+*
+* A SparseEuclideanVector can be added to, subtracted from and dotted with another sparse
+* vector or a dense EuclideanVector, and converts explicitly to and from EuclideanVector.
+* As with EuclideanVector, operations on vectors of different dimensions throw an
+* EuclideanVectorError.
+*/
+
+#ifndef ASSIGNMENTS_EV_SPARSE_EUCLIDEAN_VECTOR_H_
+#define ASSIGNMENTS_EV_SPARSE_EUCLIDEAN_VECTOR_H_
+
+#include <iostream>
+#include <vector>
+
+#include "assignments/ev/euclidean_vector.h"
+
+// Example:
+//  SparseEuclideanVector a{100000, {3, 70000}, {1.5, -2}};
+//  SparseEuclideanVector b = a * 2;
+//  std::cout << a * b;
+// Outputs -> 12.5
+class SparseEuclideanVector {
+ public:
+  /************** constructors ******************/
+  // A vector of num_dimensions dimensions, where every magnitude is 0
+  explicit SparseEuclideanVector(int num_dimensions = 1) noexcept;
+
+  // A vector whose magnitude at indices[i] is values[i], and 0 everywhere else. The indices
+  // needn't be sorted; the values of repeated indices are summed.
+  // Throws an EuclideanVectorError if an index is out of bounds, or if indices and values
+  // aren't the same length.
+  SparseEuclideanVector(int num_dimensions, const std::vector<int>& indices,
+                        const std::vector<double>& values);
+
+  // Keeps the non-zero magnitudes of ev
+  explicit SparseEuclideanVector(const EuclideanVector& ev);
+
+  /************** friend overloads ******************/
+  // Prints each non-zero magnitude as index:value, e.g. [3:1.5 70000:-2]
+  friend std::ostream& operator<<(std::ostream&, const SparseEuclideanVector&) noexcept;
+  friend SparseEuclideanVector operator+(const SparseEuclideanVector&,
+                                         const SparseEuclideanVector&);
+  friend SparseEuclideanVector operator-(const SparseEuclideanVector&,
+                                         const SparseEuclideanVector&);
+  friend EuclideanVector operator+(const SparseEuclideanVector&, const EuclideanVector&);
+  friend EuclideanVector operator+(const EuclideanVector&, const SparseEuclideanVector&);
+  friend EuclideanVector operator-(const SparseEuclideanVector&, const EuclideanVector&);
+  friend EuclideanVector operator-(const EuclideanVector&, const SparseEuclideanVector&);
+  // The dot products, which only visit the non-zero magnitudes of the sparse operands
+  friend double operator*(const SparseEuclideanVector&, const SparseEuclideanVector&);
+  friend double operator*(const SparseEuclideanVector&, const EuclideanVector&);
+  friend double operator*(const EuclideanVector&, const SparseEuclideanVector&);
+  friend SparseEuclideanVector operator*(const SparseEuclideanVector&, double) noexcept;
+  friend SparseEuclideanVector operator*(double, const SparseEuclideanVector&) noexcept;
+  friend SparseEuclideanVector operator/(const SparseEuclideanVector&, double);
+  friend bool operator==(const SparseEuclideanVector&, const SparseEuclideanVector&) noexcept;
+  friend bool operator!=(const SparseEuclideanVector&, const SparseEuclideanVector&) noexcept;
+
+  /************** operations ******************/
+  SparseEuclideanVector& operator+=(const SparseEuclideanVector&);
+  SparseEuclideanVector& operator-=(const SparseEuclideanVector&);
+  SparseEuclideanVector& operator*=(double) noexcept;
+  SparseEuclideanVector& operator/=(double);
+  explicit operator EuclideanVector() const;
+
+  /************** methods ******************/
+  int GetNumDimensions() const noexcept { return num_dimensions_; }
+  int GetNumNonZeros() const noexcept { return static_cast<int>(indices_.size()); }
+  // The indices of the non-zero magnitudes, in increasing order, and their values
+  const std::vector<int>& GetIndices() const noexcept { return indices_; }
+  const std::vector<double>& GetValues() const noexcept { return values_; }
+  // Throws an EuclideanVectorError if index is out of bounds
+  double at(int index) const;
+  // Sets the magnitude at index, which stops being stored if value is 0.
+  // Throws an EuclideanVectorError if index is out of bounds.
+  void Set(int index, double value);
+  double GetEuclideanNorm() const;
+  SparseEuclideanVector CreateUnitVector() const;
+
+ private:
+  // Merges the non-zeros of lhs and rhs into lhs + sign * rhs
+  static SparseEuclideanVector Merge(const SparseEuclideanVector& lhs,
+                                     const SparseEuclideanVector& rhs, double sign);
+  // Adds sign times the sparse operand to a dense copy of ev
+  static EuclideanVector AddToDense(const EuclideanVector& ev,
+                                    const SparseEuclideanVector& sparse, double sign);
+  void CheckIndex(int index) const;
+
+  int num_dimensions_;
+  std::vector<int> indices_;
+  std::vector<double> values_;
+};
+
+#endif  // ASSIGNMENTS_EV_SPARSE_EUCLIDEAN_VECTOR_H_